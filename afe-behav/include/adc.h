@@ -6,12 +6,25 @@
     @brief      module to represent the analog-to-digital converter
                 saturation (clipping) within full scale
                 number of bits
-                sampling rate
+                sampling rate (only the samples every ctx->adc_stride are read from inp and inn, at the rate of the analog modules)
     @param[in]  inp        points to the float vector of the input positive signal
     @param[in]  inn        points to the float vector of the input negative signal
-    @param[out] out        points to the boolean 2D vector (one per bit) of the output signal
+    @param[out] out        points to the vector of output codes, or to the boolean 2D vector (one per bit, MSB first) with ADC_BITPLANES
+    @param[in]  ctx        points to the simulation context
     @return     0
 */
-int adcModule(float* inp, float* inn, int** out);
+int adcModule(float* inp, float* inn, adc_out_t out, afe_ctx_t* ctx);
+
+/**
+    @brief      same as adcModule, on a chunk of size input samples (size/stride output samples)
+    @param[in]  inp        points to the float vector of the input positive signal
+    @param[in]  inn        points to the float vector of the input negative signal
+    @param[out] out        points to the vector of output codes, or to the boolean 2D vector (one per bit, MSB first) with ADC_BITPLANES
+    @param[in]  size       number of input samples in the chunk, multiple of stride
+    @param[in]  stride     distance between two ADC samples in the input vectors (ctx->adc_fs_ratio at FS, see ctx->adc_stride)
+    @param[in]  ctx        points to the simulation context
+    @return     0
+*/
+int adcModuleChunk(float* inp, float* inn, adc_out_t out, int size, int stride, afe_ctx_t* ctx);
 
 #endif // __ADC_H__
\ No newline at end of file
@@ -0,0 +1,71 @@
+#ifndef __AFE_CTX_H__
+#define __AFE_CTX_H__
+
+/**
+    @brief      fills a configuration with the default values defined in setup.h
+    @param[out] config      points to the configuration
+    @return     0
+*/
+int afe_config_default(afe_config_t* config);
+
+/**
+    @brief      sets one field of a configuration by name, e.g. "ia_cmrr=1e4" (see afe_config_t for the names and units)
+                white spaces around the name and the value are ignored, strings are copied and kept until the end of the process
+    @param[in,out] config       points to the configuration
+    @param[in]  assignment      name=value
+    @return     1 if the field is unknown or the value invalid, else 0
+*/
+int afe_config_set(afe_config_t* config, const char* assignment);
+
+/**
+    @brief      sets the fields of a configuration from a file with one name = value assignment per line (see afe_config_set),
+                text after # ignored, fields not in the file keep their value
+    @param[in,out] config       points to the configuration
+    @param[in]  filename        path to the configuration file
+    @return     1 if the file could not be opened or a line is invalid (the other lines are still applied), else 0
+*/
+int afe_config_load(afe_config_t* config, const char* filename);
+
+/**
+    @brief      writes all fields of a configuration, one name = value per line (can be read back by afe_config_load)
+    @param[in]  config      points to the configuration
+    @param[in]  file        output stream
+    @return     0
+*/
+int afe_config_write(const afe_config_t* config, FILE* file);
+
+/**
+    @brief      initializes a simulation context: copies the configuration, derives the rates of the module chain and the
+                filter coefficients (look-up tables for the default cutoffs, designed at run time otherwise, memoized), allocates the vectors of the module chain (one chunk of config->chunk_nsamples samples)
+                and zeroes the states
+                the context must be freed with afe_ctx_free, even if the initialization failed
+    @param[out] ctx         points to the context
+    @param[in]  config      points to the configuration, NULL for the defaults
+    @return     1 if the configuration is invalid or memory allocation failed, else 0
+*/
+int afe_ctx_init(afe_ctx_t* ctx, const afe_config_t* config);
+
+/**
+    @brief      frees the vectors of a simulation context
+    @param[in]  ctx         points to the context
+    @return     0
+*/
+int afe_ctx_free(afe_ctx_t* ctx);
+
+/**
+    @brief      zeroes the filter and noise states of a simulation context, so that the next buffer starts from scratch
+    @param[in,out] ctx      points to the context
+    @return     0
+*/
+int afe_ctx_reset(afe_ctx_t* ctx);
+
+/**
+    @brief      seeds the random number generators of a simulation context (one per noise source) from config.seed
+    @param[in,out] ctx      points to the context
+    @param[in]  subject_idx index of the subject in subject_list
+    @param[in]  buffer_idx  index of the buffer, RNG_BUFFER_ALL for the noise of a whole recording
+    @return     0
+*/
+int afe_ctx_seed(afe_ctx_t* ctx, uint32_t subject_idx, uint32_t buffer_idx);
+
+#endif // __AFE_CTX_H__
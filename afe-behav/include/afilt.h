@@ -7,12 +7,29 @@
                 gain
                 high-pass and low-pass filtering
                 saturation (clipping)
+                at the rate of the analog modules (ctx->analog_fs, ctx->analog_nsamples samples)
+                the filters run on all samples, the memoryless stages (saturation, DC value) only every stride samples
     @param[in]  in          points to the vector of the input signal
-    @param[out] outp        points to the vector of the positive output signal
-    @param[out] outn        points to the vector of the negative output signal
+    @param[out] outp        points to the vector of the positive output signal, valid every stride samples
+    @param[out] outn        points to the vector of the negative output signal, valid every stride samples
+    @param[in]  stride      distance between the output samples read by the consumer (ctx->adc_stride for the ADC, 1 for all)
+    @param[in,out] ctx      points to the simulation context (configuration, filter states zeroed by afe_ctx_reset for a new buffer)
     @return     0
 */
-int afiltModule(float* in, float* outp, float* outn);
+int afiltModule(float* in, float* outp, float* outn, int stride, afe_ctx_t* ctx);
+
+/**
+    @brief      same as afiltModule, on a chunk of size samples, starting from and updating the filter states
+                outp is used as working vector, so that no intermediate vector is needed
+    @param[in]  in          points to the vector of the input signal
+    @param[out] outp        points to the vector of the positive output signal, valid every stride samples
+    @param[out] outn        points to the vector of the negative output signal, valid every stride samples
+    @param[in]  size        number of samples in the chunk at the rate of the analog modules, multiple of stride
+    @param[in]  stride      distance between the output samples read by the consumer
+    @param[in,out] ctx      points to the simulation context (configuration and filter states)
+    @return     0
+*/
+int afiltModuleChunk(float* in, float* outp, float* outn, int size, int stride, afe_ctx_t* ctx);
 
 #endif // __AFILT_H__
 
@@ -4,10 +4,43 @@
 
 /**
     @brief      module to represent the decimation operation
+                average of 2^osr_log samples (ctx->config.osr_log), rounded and bounded as the digital filters with DFILT_FIXED
     @param[in]  in         points to the integer vector of the input signal
     @param[out] out        points to the integer vector of the output signal 
+    @param[in]  ctx        points to the simulation context
     @return     0
 */
-int decimModule(int* in, int* out);
+int decimModule(int* in, int* out, afe_ctx_t* ctx);
+
+/**
+    @brief      same as decimModule, on a chunk of size samples at the ADC rate (size >> osr_log output samples)
+    @param[in]  in         points to the integer vector of the input signal
+    @param[out] out        points to the integer vector of the output signal 
+    @param[in]  size       number of input samples in the chunk, multiple of 2^osr_log
+    @param[in]  ctx        points to the simulation context
+    @return     0
+*/
+int decimModuleChunk(int* in, int* out, int size, afe_ctx_t* ctx);
+
+/**
+    @brief      module to represent the digital filters and the decimation at once, in place of dfiltModule then decimModule
+                the ADC codes are filtered by tiles of DECIM_TILE_NSAMPLES samples and only the decimated outputs are stored,
+                bit-identical to the two modules (same kernels and block boundaries), without the full-rate vector
+    @param[in]  in         points to the vector of ADC codes, or to the boolean 2D vector (one per bit, MSB first) with ADC_BITPLANES
+    @param[out] out        points to the integer vector of the output signal 
+    @param[in,out] ctx     points to the simulation context (filter states, zeroed by afe_ctx_reset for a new buffer)
+    @return     0
+*/
+int dfiltDecimModule(adc_out_t in, int* out, afe_ctx_t* ctx);
+
+/**
+    @brief      same as dfiltDecimModule, on a chunk of size samples at the ADC rate (size >> osr_log output samples)
+    @param[in]  in         points to the vector of ADC codes, or to the boolean 2D vector (one per bit, MSB first) with ADC_BITPLANES
+    @param[out] out        points to the integer vector of the output signal 
+    @param[in]  size       number of input samples in the chunk, multiple of 2^osr_log
+    @param[in,out] ctx     points to the simulation context (filter states)
+    @return     0
+*/
+int dfiltDecimModuleChunk(adc_out_t in, int* out, int size, afe_ctx_t* ctx);
 
 #endif // __DECIM_H__
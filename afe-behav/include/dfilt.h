@@ -5,11 +5,23 @@
 /**
     @brief      module to represent the digital filters
                 low-pass and high-pass filtering
-    @param[in]  in         points to the boolean 2D vector (one per bit) of the input signal
+                float reference, or bit-true fixed-point model with DFILT_FIXED (see iir_order_2_fixed_chunk)
+    @param[in]  in         points to the vector of ADC codes, or to the boolean 2D vector (one per bit, MSB first) with ADC_BITPLANES
     @param[out] out        points to the integer vector of the output signal 
+    @param[in,out] ctx     points to the simulation context (filter states, zeroed by afe_ctx_reset for a new buffer)
     @return     0
 */
-int dfiltModule(int** in, int* out);
+int dfiltModule(adc_out_t in, int* out, afe_ctx_t* ctx);
+
+/**
+    @brief      same as dfiltModule, on a chunk of size samples at the ADC rate, starting from and updating the filter states
+    @param[in]  in         points to the vector of ADC codes, or to the boolean 2D vector (one per bit, MSB first) with ADC_BITPLANES
+    @param[out] out        points to the integer vector of the output signal 
+    @param[in]  size       number of samples in the chunk
+    @param[in,out] ctx     points to the simulation context (filter states)
+    @return     0
+*/
+int dfiltModuleChunk(adc_out_t in, int* out, int size, afe_ctx_t* ctx);
 
 #endif // __DFILT_H__
 
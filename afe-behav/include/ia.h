@@ -5,18 +5,44 @@
 /**
     @brief      module to represent the instrumentation 
                 gain
-                summation of the two input channels
+                summation of the two input channels (already averaged upstream with COLLAPSE_LINEAR)
                 finite CMRR
                 addition of white and pink noise
                 low-pass filtering at the output
+                at the rate of the analog modules (ctx->analog_fs, ctx->analog_nsamples samples)
     @param[in]  in1d        points to the vector of input 1 differential mode
     @param[in]  in2d        points to the vector of input 2 differential mode  
     @param[in]  in1c        points to the vector of input 1 common mode
     @param[in]  in2c        points to the vector of input 2 common mode  
     @param[out] out         points to the vector of the output signal
+    @param[in,out] ctx      points to the simulation context (configuration, states, random number generator and noise vector)
     @return     0
 */
-int iaModule(float* in1d, float* in2d, float* in1c, float* in2c, float* out);
+int iaModule(float* in1d, float* in2d, float* in1c, float* in2c, float* out, afe_ctx_t* ctx);
+
+/**
+    @brief      same as iaModule, on a chunk of size samples, starting from and updating the filter state
+                the noise is not generated here but given as an input (see ia_noise_generator)
+    @param[in]  in1d        points to the vector of input 1 differential mode
+    @param[in]  in2d        points to the vector of input 2 differential mode  
+    @param[in]  in1c        points to the vector of input 1 common mode
+    @param[in]  in2c        points to the vector of input 2 common mode  
+    @param[in]  noise       points to the vector of input-referred noise (ignored if NOISY is not defined)
+    @param[out] out         points to the vector of the output signal
+    @param[in]  size        number of samples in the chunk, at the rate of the analog modules (ctx->analog_fs)
+    @param[in,out] ctx      points to the simulation context (configuration and filter state)
+    @return     0
+*/
+int iaModuleChunk(float* in1d, float* in2d, float* in1c, float* in2c, float* noise, float* out, int size, afe_ctx_t* ctx);
+
+/**
+    @brief      generates the input-referred noise of the IA (white and pink)
+    @param[out] noise       points to the vector of noise
+    @param[in]  size        number of samples to generate
+    @param[in,out] ctx      points to the simulation context (configuration, pink noise generator and random number generator)
+    @return     0
+*/
+int ia_noise_generator(float* noise, int size, afe_ctx_t* ctx);
 
 #endif // __IA_H__
 
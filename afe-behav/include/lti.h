@@ -0,0 +1,48 @@
+
+#ifndef __LTI_H__
+#define __LTI_H__
+
+/**
+    @brief      builds the overlap-save FIR filter of the linear path (LTI_FFT) from the analog filter coefficients
+                and the gains of the context: impulse responses of the PCB HPF, IA LPF and AFILT LPF (signal) and of the
+                IA LPF and AFILT LPF (IA noise), computed in double and truncated below LTI_FFT_TOL times their peak
+    @param[in,out] ctx      points to the simulation context (configuration and analog filter coefficients, ctx->lti allocated)
+    @return     1 if memory allocation failed, else 0
+*/
+int ltiInit(afe_ctx_t* ctx);
+
+/**
+    @brief      module to represent the linear path of the front end at once, in place of pcbModule, iaModule and the gain
+                and LPF of afiltModule (LTI_FFT)
+                the AFILT HPF and the saturation are still applied by afiltModule
+    @param[in]  in1d        points to the vector of input 1 differential mode
+    @param[in]  in2d        points to the vector of input 2 differential mode
+    @param[in]  in1c        points to the vector of input 1 common mode
+    @param[in]  in2c        points to the vector of input 2 common mode
+    @param[out] out         points to the vector of the output signal (input of the AFILT HPF)
+    @param[in,out] ctx      points to the simulation context (configuration, filter, random number generator and noise vector)
+    @return     0
+*/
+int ltiModule(float* in1d, float* in2d, float* in1c, float* in2c, float* out, afe_ctx_t* ctx);
+
+/**
+    @brief      same as ltiModule, on a chunk of size samples, starting from and updating the filter state (input history)
+                the signal and the IA noise are filtered together as the real and imaginary parts of one FFT,
+                by segments of up to nfft-ntaps+1 samples (the chunk size only changes the float rounding)
+                outputs match the cascaded IIR filters within the truncation tolerance LTI_FFT_TOL and the float
+                rounding of the FFTs: the AFILT output is within 3e-5 of its RMS (1e-4 at the peak), full buffers or chunks,
+                against the cascade with IIR_DELTA (checked by make test, see test/chain_test.c; the direct-form AFILT biquads
+                are themselves off by about 2 % in float)
+    @param[in]  in1d        points to the vector of input 1 differential mode
+    @param[in]  in2d        points to the vector of input 2 differential mode
+    @param[in]  in1c        points to the vector of input 1 common mode
+    @param[in]  in2c        points to the vector of input 2 common mode
+    @param[in]  noise       points to the vector of IA input-referred noise (ignored if NOISY is not defined)
+    @param[out] out         points to the vector of the output signal (input of the AFILT HPF)
+    @param[in]  size        number of samples in the chunk, at the rate of the analog modules (ctx->analog_fs)
+    @param[in,out] ctx      points to the simulation context (configuration and filter)
+    @return     0
+*/
+int ltiModuleChunk(float* in1d, float* in2d, float* in1c, float* in2c, float* noise, float* out, int size, afe_ctx_t* ctx);
+
+#endif // __LTI_H__
@@ -0,0 +1,70 @@
+
+#ifndef __NOISE_BANK_H__
+#define __NOISE_BANK_H__
+
+/**
+    @brief      generates the noise bank of a configuration (NOISE_BANK) if its file does not exist yet or does not match:
+                for each noise source (RNG_STREAM_*), a ring of config.noise_bank_nbuffers buffers of unit gaussian noise and one of
+                Voss-McCartney pink noise of unit sources, at the analog rate, drawn from config.seed
+                the end of the pink noise rings fades into their start over NOISE_BANK_NFADE samples (no jump at the wrap)
+                the file <run folder>NOISE_BANK_NAME_<seed>_<analog rate>_<buffers>.bin is written under a temporary name, then renamed
+                called once before the worker threads map the bank (see noise_bank_open)
+    @param[in]  config      points to the configuration of the run (run folder, seed, analog rate and number of buffers)
+    @return     1 if the file could not be written, else 0
+*/
+int noise_bank_build(const afe_config_t* config);
+
+/**
+    @brief      maps the noise bank of a configuration (read only, shared with the other contexts through the page cache)
+    @param[out] bank        points to the noise bank
+    @param[in]  config      points to the configuration of the context (run folder, seed, analog rate and number of buffers)
+    @return     1 if the file could not be opened or does not match the configuration (see noise_bank_build), else 0
+*/
+int noise_bank_open(noise_bank_t* bank, const afe_config_t* config);
+
+/**
+    @brief      unmaps a noise bank
+    @param[in,out] bank     points to the noise bank, can be closed already
+    @return     0
+*/
+int noise_bank_close(noise_bank_t* bank);
+
+/**
+    @brief      sets the power of the noise read from one source of the bank, same power and spectrum as
+                mixed_noise_generator_chunk with the same parameters (see mixed_noise_scales)
+    @param[in,out] bank     points to the noise bank
+    @param[in]  source      index of the noise source (RNG_STREAM_*)
+    @param[in]  fs          sampling rate of the noise in Hz, the powers are still defined at FS
+    @param[in]  power       noise power in V^2
+    @param[in]  fcorner     noise corner frequency in Hz
+    @param[in]  power_band  points to the vector defining the bandwidth in which the noise power is computed
+    @return     0
+*/
+int noise_bank_set_power(noise_bank_t* bank, int source, int fs, float power, float fcorner, float* power_band);
+
+/**
+    @brief      moves the reading positions of all sources to the start of a stream of buffers, any sample of the rings
+                drawn from the seed, the subject and the buffer index (same noise for the same buffer in every run of the seed)
+                buffers read windows wrapping around the end of the rings, starting at any of their samples: the bank only holds
+                config.noise_bank_nbuffers buffers of independent noise, so the windows of two buffers partly overlap with
+                probability 2 / noise_bank_nbuffers
+    @param[in,out] bank         points to the noise bank
+    @param[in]  seed            seed of the run
+    @param[in]  subject_idx     index of the subject in subject_list
+    @param[in]  buffer_idx      index of the buffer, RNG_BUFFER_ALL for the stream of a whole recording
+    @return     0
+*/
+int noise_bank_seek(noise_bank_t* bank, uint64_t seed, uint32_t subject_idx, uint32_t buffer_idx);
+
+/**
+    @brief      reads a chunk of noise of one source, continuing from its reading position (wraps around the ring)
+                noise = white_scale * white + pink_scale * pink, no random number is drawn
+    @param[out] noise       points to the output vector of noise
+    @param[in]  size        number of samples in the output vector
+    @param[in,out] bank     points to the noise bank
+    @param[in]  source      index of the noise source (RNG_STREAM_*)
+    @return     0
+*/
+int noise_bank_chunk(float* noise, int size, noise_bank_t* bank, int source);
+
+#endif // __NOISE_BANK_H__
@@ -4,7 +4,8 @@
 
 /**
     @brief      module to represent the off-chip components of the front end
-                high-pass filtering function
+                high-pass filtering function, at the rate of the analog modules (ctx->analog_fs, ctx->analog_nsamples samples)
+                with COLLAPSE_LINEAR, only in1d and in1c (averages of the two inputs) are filtered into out1d and out1c
     @param[in]  in1d        points to the vector of input 1 differential mode
     @param[in]  in2d        points to the vector of input 2 differential mode  
     @param[in]  in1c        points to the vector of input 1 common mode
@@ -13,9 +14,26 @@
     @param[out] out2d       points to the vector of output 2 differential mode  
     @param[out] out1c       points to the vector of output 1 common mode
     @param[out] out2c       points to the vector of output 2 common mode  
+    @param[in,out] ctx      points to the simulation context (filter states, zeroed by afe_ctx_reset for a new buffer)
     @return     0
 */
-int pcbModule(float* in1d, float* in2d, float* in1c, float* in2c, float* out1d, float* out2d, float* ou1c, float* out2c);
+int pcbModule(float* in1d, float* in2d, float* in1c, float* in2c, float* out1d, float* out2d, float* out1c, float* out2c, afe_ctx_t* ctx);
+
+/**
+    @brief      same as pcbModule, on a chunk of size samples, starting from and updating the filter states
+    @param[in]  in1d        points to the vector of input 1 differential mode
+    @param[in]  in2d        points to the vector of input 2 differential mode  
+    @param[in]  in1c        points to the vector of input 1 common mode
+    @param[in]  in2c        points to the vector of input 2 common mode  
+    @param[out] out1d       points to the vector of output 1 differential mode
+    @param[out] out2d       points to the vector of output 2 differential mode  
+    @param[out] out1c       points to the vector of output 1 common mode
+    @param[out] out2c       points to the vector of output 2 common mode  
+    @param[in]  size        number of samples in the chunk, at the rate of the analog modules (ctx->analog_fs)
+    @param[in,out] ctx      points to the simulation context (filter states)
+    @return     0
+*/
+int pcbModuleChunk(float* in1d, float* in2d, float* in1c, float* in2c, float* out1d, float* out2d, float* out1c, float* out2c, int size, afe_ctx_t* ctx);
 
 #endif // __PCB_H__
 
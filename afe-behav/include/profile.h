@@ -0,0 +1,63 @@
+
+#ifndef __PROFILE_H__
+#define __PROFILE_H__
+
+/**
+    @brief      allocates and zeroes the timings of a run
+    @param[out] profile     points to the timings
+    @param[in]  nthreads    number of worker threads of the run (reported)
+    @return     1 if memory allocation failed, else 0
+*/
+int profile_init(profile_t* profile, int nthreads);
+
+/**
+    @brief      frees the timings of a run
+    @param[in,out] profile  points to the timings
+    @return     0
+*/
+int profile_free(profile_t* profile);
+
+/**
+    @brief      timings of one buffer of a run, marked as timed
+    @param[in]  profile         points to the timings of the run, can be NULL
+    @param[in]  subject_idx     index of the subject in subject_list
+    @param[in]  buffer_idx      index of the buffer
+    @return     pointer to the timings of the buffer, NULL if profile is NULL
+*/
+profile_buffer_t* profile_buffer(profile_t* profile, int subject_idx, int buffer_idx);
+
+/**
+    @brief      writes the timings of a run: per buffer to RUN_FOLDER/RUN_CATEGORY/profile.csv (one line per buffer, seconds per
+                stage), per stage and per subject to profile.json (seconds, samples, samples per second), and prints a summary
+                with the real-time factor (seconds of signal simulated per second of wall time)
+    @param[in]  profile     points to the timings of the run
+    @param[in]  config      points to the configuration of the run (output folders)
+    @return     1 if a report file could not be opened, else 0
+*/
+int profile_report(profile_t* profile, const afe_config_t* config);
+
+/**
+    @brief      monotonic wall clock
+    @return     time in seconds from an arbitrary origin
+*/
+double profile_now(void);
+
+// Adds the time since start and the samples of one call of a stage to the timings of a buffer (can be NULL)
+static inline void profile_add(profile_buffer_t* buffer, int stage, double start, int nsamples) {
+
+    if (buffer != NULL) {
+        buffer->seconds[stage] += profile_now() - start;
+        buffer->nsamples[stage] += nsamples;
+    }
+}
+
+// Times the code between PROFILE_START and PROFILE_STOP, nothing without PROFILE
+#ifdef PROFILE
+    #define PROFILE_START(start) double start = profile_now()
+    #define PROFILE_STOP(start, buffer, stage, nsamples) profile_add(buffer, stage, start, nsamples)
+#else
+    #define PROFILE_START(start)
+    #define PROFILE_STOP(start, buffer, stage, nsamples)
+#endif // PROFILE
+
+#endif // __PROFILE_H__
@@ -0,0 +1,77 @@
+#ifndef __RUN_H__
+#define __RUN_H__
+
+/**
+    @brief      runs the whole module chain on one buffer of a subject, the output is left in ctx->out
+                without CONTINUOUS the random number generators of the context are seeded from config.seed, the subject and the buffer index,
+                so that the output does not depend on which worker runs the buffer
+                with ALLOC_COUNT the buffer fails if it allocates heap memory and is not the first one run by the context
+    @param[in,out] ctx          points to the simulation context
+    @param[in]  subject_idx     index of the subject in subject_list
+    @param[in]  buffer_idx      index of the buffer
+    @param[out] out_segment     points to the output samples to write (part of ctx->out)
+    @param[out] out_nsamples    number of output samples to write
+    @return     1 if the buffer could not be read (or allocated after warm-up), else 0
+*/
+int run_buffer(afe_ctx_t* ctx, int subject_idx, int buffer_idx, int** out_segment, int* out_nsamples);
+
+/**
+    @brief      writes the output of one buffer to its file
+    @param[in]  out             output samples
+    @param[in]  out_nsamples    number of output samples
+    @param[in]  subject_idx     index of the subject in subject_list
+    @param[in]  buffer_idx      index of the buffer
+    @param[in]  ctx             points to the simulation context (output folders)
+    @return     1 if the file could not be opened, else 0
+*/
+int write_buffer_output(int* out, int out_nsamples, int subject_idx, int buffer_idx, afe_ctx_t* ctx);
+
+/**
+    @brief      runs the whole module chain on all buffers of one subject and writes the outputs to files
+                with CONTINUOUS the random number generators of the context are seeded once from config.seed and the subject index
+    @param[in,out] ctx          points to the simulation context
+    @param[in]  subject_idx     index of the subject in subject_list
+    @return     1 if a buffer could not be read, else 0
+*/
+int run_subject(afe_ctx_t* ctx, int subject_idx);
+
+/**
+    @brief      runs the given subjects, in parallel on nthreads worker threads (each thread takes the next subject not started yet)
+    @param[in]  nthreads    number of worker threads
+    @param[in]  subjects    indices of the subjects in subject_list
+    @param[in]  nsubjects   number of subjects
+    @param[in]  config      points to the configuration of the simulation contexts (one per thread)
+    @return     1 if a subject failed, else 0
+*/
+int run_subjects(int nthreads, int* subjects, int nsubjects, const afe_config_t* config);
+
+/**
+    @brief      runs all buffers of the given subjects, in parallel on nthreads worker threads
+                buffers are dealt round-robin to the workers, an idle worker steals the oldest buffer of the most loaded one
+                outputs are written in order as soon as all previous buffers are done, outside of the scheduler lock
+                a worker does not start a buffer more than MAX_PENDING_PER_THREAD * nthreads after the next one to write,
+                which bounds the outputs held in memory
+                with CONTINUOUS buffers depend on the previous one, so this falls back to run_subjects
+    @param[in]  nthreads    number of worker threads
+    @param[in]  subjects    indices of the subjects in subject_list
+    @param[in]  nsubjects   number of subjects
+    @param[in]  config      points to the configuration of the simulation contexts (one per thread)
+    @return     1 if a buffer failed, else 0
+*/
+int run_buffers(int nthreads, int* subjects, int nsubjects, const afe_config_t* config);
+
+/**
+    @brief      runs the given subjects once per point of a sweep file (see run_buffers), in the order of the file
+                each line holds the name=value overrides of the base configuration for one point (see afe_config_set),
+                separated by white spaces, text after # ignored, e.g. "ia_cmrr=1e4 adc_nbits=10 run_folder=cmrr_1e4"
+                filter coefficients are designed once per set of cutoffs (memoized across points)
+    @param[in]  nthreads        number of worker threads
+    @param[in]  subjects        indices of the subjects in subject_list
+    @param[in]  nsubjects       number of subjects
+    @param[in]  config          points to the base configuration
+    @param[in]  sweep_filename  path to the sweep file
+    @return     1 if the file could not be opened or a point failed (the other points still run), else 0
+*/
+int run_sweep(int nthreads, int* subjects, int nsubjects, const afe_config_t* config, const char* sweep_filename);
+
+#endif // __RUN_H__
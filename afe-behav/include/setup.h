@@ -2,11 +2,16 @@
 #ifndef __SETUP_H__
 #define __SETUP_H__
 
+#include <stddef.h>
+#include <stdint.h>
+
 ///////////////////////////////////////////
 //   RUN OPTIONS
 ///////////////////////////////////////////
 
 // #define DO_PRINT // Print progress and info at every buffer (slows down simulation)
+// #define PROFILE // Time each stage of the module chain per buffer, reported at the end of a run (see profile_report)
+// #define ALLOC_COUNT // Count the heap allocations of each thread: a buffer allocating after the first one of its context fails (see alloc_count)
 
 #define NSUBJECTS 8 // Number of subjects studied
 extern const char* subject_list[];
@@ -14,9 +19,36 @@ extern const char* subject_list[];
 #define VENG_DATA_FOLDER "../dummy_inputs/" // Folder where experimental data buffers are stored
 #define RUN_FOLDER "../outputs/" // General folder to store the results
 #define RUN_CATEGORY "test" // Sub-folder in RUN_FOLDER
+#define NOISE_BANK_NAME "noise_bank" // Name of the noise bank files in the run folder (NOISE_BANK), followed by _<seed>_<analog rate>_<buffers>.bin
 
 #define NOISY // Add noise in the IA (slows down simulation)
+// #define NOISE_SYNTH // Synthesize the CM and IA noises from shaped random spectra with inverse FFTs instead of the time-domain white and pink generators (see noise_synth_chunk)
+// #define NOISE_BANK // Read the CM and IA noises from a memory-mapped bank of unit white and pink noise scaled by the configuration, generated once per seed and analog rate (see noise_bank_build)
+                      // Takes precedence over NOISE_SYNTH, the runs of a seed share the same noise whatever the noise powers (common random numbers)
 #define SATURATE // Apply saturation on AFILT outputs
+// #define SAT_LIBM // Compute the saturation curves with libm (sinf, tanhf) instead of the vectorized polynomial approximations (reference runs)
+// #define GAUSS_LIBM // Compute the Box-Muller transform of the Gaussian noise with libm (logf, sinf, cosf) instead of the vectorized polynomial approximations (reference runs)
+// #define ADC_BITPLANES // The ADC outputs one int vector per bit (MSB first) instead of packed codes, for bit-level experiments (e.g. bit errors)
+// #define COLLAPSE_LINEAR // Average the two inputs before the PCB filters (linear), with one CM noise stream of half the power
+                           // Only in1d and in1c are used (holding the averages), the reference chain runs without it
+// #define LTI_FFT // Apply the linear path from the PCB to the AFILT LPF as one FIR filter with overlap-save FFTs (not bit-exact, see ltiModuleChunk)
+                   // The AFILT HPF (7 and 48 Hz poles, too long an impulse response) stays a recursive filter
+
+// #define STREAM // Push chunks of STREAM_NSAMPLES through the whole module chain instead of full buffers (same outputs, smaller working set)
+#define STREAM_NSAMPLES 6400 // Chunk size at FS in stream mode, must be a multiple of OUT_FS_RATIO, INPUT_FS_RATIO and ANALOG_FS_RATIO
+
+// #define CONTINUOUS // Simulate each 0.5-s hop only once, carrying all filter and noise states from one buffer to the next
+
+// Stream and continuous modes both push chunks through the module chain
+#if defined(STREAM) || defined(CONTINUOUS)
+    #define CHUNKED
+#endif
+
+#define CONFIG_LINE_MAX 1024 // Longest line of the configuration and sweep files (see afe_config_load and run_sweep)
+
+#define N_THREADS 1 // Number of worker threads running subjects in parallel (can be overridden by the first command-line argument)
+#define MAX_PENDING_PER_THREAD 4 // Outputs waiting to be written in order per worker thread of run_buffers, a worker waits beyond
+#define SEED 1 // Seed of the noise generators, the outputs only depend on it (not on the number of threads)
 
 ///////////////////////////////////////////
 //   CONSTANTS
@@ -24,6 +56,8 @@ extern const char* subject_list[];
 
 #define FS 640000 // General time resolution for all analog functions
 #define N_SAMPLES 640000 // Number of samples at FS in a buffer (1-second buffers)
+#define ANALOG_FS_RATIO 1 // The analog modules (PCB, IA, AFILT) run at FS/ANALOG_FS_RATIO, 4 runs them at the ADC rate (faster, not bit-exact)
+                          // Must divide INPUT_FS_RATIO and the ADC rate ratio (ADC_FREQUENCY_RATIO at ADC_OSR_LOG), can be changed at run time (see afe_config_t)
 
 #define PI 3.1415926535897932384626433
 #define TWO_PI (2*PI)
@@ -45,6 +79,21 @@ extern const char* subject_list[];
 #define INPUT_FS_RATIO 8 // 80 kS/s = FS/8
 #define INPUT_NSAMPLES (N_SAMPLES / INPUT_FS_RATIO)
 
+// Interpolation of the experimental data to the analog rate (see oversample_input)
+#define INPUT_INTERP INTERP_LINEAR // Can be changed at run time (see afe_config_t)
+#define INTERP_LINEAR 0 // Linear interpolation between consecutive samples
+#define INTERP_SINC 1 // Polyphase windowed-sinc FIR (anti-imaging), reads INTERP_NTAPS/2-1 inputs ahead to compensate its delay
+#define INTERP_NTAPS 8 // Taps per phase of the INTERP_SINC filter (even), can be changed at run time
+#define INTERP_NTAPS_MAX 16 // Longest run-time INTERP_SINC filter
+#define INTERP_TILE_NSAMPLES 512 // Input samples converted to float at once, in a stack tile
+// #define INTERP_DOUBLE // Scalar linear interpolation in double (reference) instead of the vectorized float polyphase interpolator
+#define STIMULI_INPUT_NSAMPLES (INPUT_NSAMPLES + INTERP_NTAPS_MAX / 2) // Inputs of a buffer and those read ahead by INTERP_SINC (stream and continuous modes)
+
+// In continuous mode, only the central half of each overlapping buffer is simulated
+// (the first buffer also simulates its first quarter, as settling time)
+#define HOP_NSAMPLES (N_SAMPLES / 2) // 0.5-s hop between two consecutive buffers
+#define HOP_OFFSET (N_SAMPLES / 4) // Start of the hop in each buffer
+
 #define INPUT_CM 1e-3 // 1 mV
 // Input CM power is integrated from INPUT_CM_FMIN to INPUT_CM_FMAX
 #define INPUT_CM_FMIN 1.0f // 1 Hz
@@ -76,20 +125,28 @@ extern const char* subject_list[];
 #define AFILT_FH 3000 // 3 kHz
 #define AFILT_DC_OUT 0.6f // 0.6 V = VDD/2 (DC common-mode voltage)
 #define AFILT_DR_MAX 0.75f // 0.75 V (saturation voltage)
+#define AFILT_SAT_CURVE SAT_CURVE_SINE // Compression curve of the saturation (see saturate), can be changed at run time (see afe_config_t)
+
+// Saturation curves y = vsat * f(x / vsat)
+#define SAT_CURVE_SINE 0 // f = sin up to pi/2, clipped beyond
+#define SAT_CURVE_TANH 1 // f = tanh
+#define SAT_CURVE_PIECEWISE 2 // f linear up to SAT_KNEE, then a parabola reaching 1 with a zero slope at 2 - SAT_KNEE
+#define SAT_KNEE 0.8f
 
 ///////////////////////////////////////////
 //   ADC
 ///////////////////////////////////////////
 
 #define OUT_FS_RATIO 32 // output fs = 20 kS/s = 640 kS/s / 32
-#define ADC_OSR_LOG 3 // LOG2(OSR) = LOG2(8) = 3 (ADC oversampling)
-#define ADC_FREQUENCY_RATIO (OUT_FS_RATIO >> ADC_OSR_LOG)
-#define ADC_NSAMPLES (N_SAMPLES / ADC_FREQUENCY_RATIO)
+#define ADC_OSR_LOG 3 // LOG2(OSR) = LOG2(8) = 3 (ADC oversampling), can be changed at run time (see afe_config_t): the ADC rate follows, the output rate stays FS/OUT_FS_RATIO
+#define ADC_FREQUENCY_RATIO (OUT_FS_RATIO >> ADC_OSR_LOG) // At ADC_OSR_LOG, see ctx->adc_fs_ratio
+#define ADC_NSAMPLES (N_SAMPLES / ADC_FREQUENCY_RATIO) // At ADC_OSR_LOG, see ctx->adc_nsamples
 #define ADC_FULLSCALE 1.824f // max value - min value, in V
 #define ADC_MIDRANGE 0.6 // in V
 #define ADC_VMIN (ADC_MIDRANGE - ADC_FULLSCALE/4)
 #define ADC_VMAX (ADC_MIDRANGE + ADC_FULLSCALE/4)
-#define ADC_NBITS 12
+#define ADC_NBITS 12 // Can be changed at run time (see afe_config_t)
+#define ADC_NBITS_MAX 16 // Largest run-time resolution (codes packed in 16 bits, up to OUT_NBITS)
 #define ADC_INTMAX (pow(2, ADC_NBITS)-1)
 
 ///////////////////////////////////////////
@@ -100,17 +157,330 @@ extern const char* subject_list[];
 #define DFILT_FL 200 // 200 Hz
 #define DFILT_FH 3000 // 3 kHz
 
+// #define DFILT_FIXED // Bit-true fixed-point digital filters and decimation instead of the float reference (see iir_order_2_fixed_chunk)
+#define DFILT_COEF_FRAC 28 // Fractional bits of the filter coefficients (the DFILT HPF needs about 28 to stay within 1 LSB of a double model)
+#define DFILT_STATE_FRAC 12 // Fractional bits kept on the recursive outputs below the OUT_NBITS integer data
+#define DFILT_ACC_BITS 60 // Width of the multiply-accumulate register, two's complement, up to 63 bits (products of 16-bit data and Q28 coefficients with 12 extra bits need 59)
+#define DFILT_ROUNDING 1 // Rounding of the shifted accumulators: 0 truncation (toward -inf), 1 to nearest (half up)
+#define DFILT_SATURATION 1 // Overflow of the accumulators and data: 0 wrap-around, 1 saturation
+
 ///////////////////////////////////////////
 //   DECIMATION
 ///////////////////////////////////////////
 
 #define OUT_NSAMPLES ((int)(N_SAMPLES / OUT_FS_RATIO))
+#define HOP_OUT_NSAMPLES ((int)(HOP_NSAMPLES / OUT_FS_RATIO)) // Output samples per buffer in continuous mode
+
+// #define DECIM_UNFUSED // Run dfiltModule then decimModule on full-rate vectors instead of the fused dfiltDecimModule (reference)
+#define DECIM_TILE_NSAMPLES 1024 // ADC samples filtered at a time by dfiltDecimModule (4 kB, fits in L1 cache), multiple of IIR_BLOCK_NSAMPLES
+#define DECIM_OSR_LOG_MAX 10 // Largest run-time oversampling, 2^DECIM_OSR_LOG_MAX must divide DECIM_TILE_NSAMPLES (the ADC rate also bounds it, up to FS)
 
 ///////////////////////////////////////////
 //   MISC
 ///////////////////////////////////////////
 
 #define PINK_NOISE_NSOURCES 16 // Parameter for pink noise generation
+#define NOISE_TILE_NSAMPLES 1024 // Size of the stack tiles in which pink noise is generated and added to the white noise (4 kB)
+#define NOISE_SYNTH_NFFT 65536 // FFT size of the noise synthesis (NOISE_SYNTH), the 1/f noise flattens below one bin (analog_fs / NOISE_SYNTH_NFFT)
+#define NOISE_SYNTH_NFADE 4096 // Crossfade between consecutive frames of the noise synthesis
+#define NOISE_BANK_NBUFFERS 16 // Buffers of noise per source in the bank (NOISE_BANK), each buffer reads from a sample drawn from its seed (wrapping around)
+                              // Two buffers of a run share part of their noise with probability 2/NOISE_BANK_NBUFFERS, can be changed at run time (see afe_config_t)
+#define NOISE_BANK_NFADE 16384 // Crossfade of the end of the pink noise rings into their start (NOISE_BANK), no jump where the reads wrap around
+#define RNG_BATCH_NBLOCKS 8 // Philox blocks encrypted together by the batch draws, one per SIMD lane (8 lanes of 32 bits, see rng_uint32_batch)
+#define RNG_BUFFER_ALL 0xFFFFFFFFu // Buffer index of the noise streams of a whole recording (CONTINUOUS)
+
+// Noise sources, each drawing from its own random stream
+#define RNG_STREAM_CM1 0 // CM noise of input 1 (also the averaged CM noise with COLLAPSE_LINEAR)
+#define RNG_STREAM_CM2 1 // CM noise of input 2
+#define RNG_STREAM_IA 2 // IA input-referred noise
+#define N_RNG_STREAMS 3
+
+#define SCRATCH_ALIGN 64 // Alignment of the slices of the scratch memory of a context (cache line)
+
+// Stages timed with PROFILE
+#define STAGE_STIMULI 0
+#define STAGE_PCB 1
+#define STAGE_IA 2 // with the IA noise
+#define STAGE_LTI 3 // LTI_FFT only
+#define STAGE_AFILT 4
+#define STAGE_ADC 5
+#define STAGE_DFILT 6 // DECIM_UNFUSED only
+#define STAGE_DECIM 7 // DECIM_UNFUSED only
+#define STAGE_DFILT_DECIM 8
+#define STAGE_WRITE 9
+#define N_STAGES 10
+
+#define FILTER_CACHE_SIZE 16 // Filter designs memoized for the contexts created with the same rates and cutoffs (see afe_ctx_init)
+
+#define IIR_TILE_NFLOATS 1024 // Size of the stack tiles in which separate streams are interleaved (4 kB, fits in L1 cache)
+
+// #define IIR_BLOCK // Single-stream IIR filters use the block state-space kernels (faster, not bit-exact, see iir_order_2_block)
+#define IIR_BLOCK_NSAMPLES 8 // Samples computed at once by the block state-space kernels (one SIMD vector)
+
+// #define IIR_DELTA // The AFILT biquads use the delta-operator form designed from the analog prototypes (accurate in float for
+                     // any low cutoff, see iir_order_2_delta_chunk) instead of the look-up coefficients, over IIR_BLOCK
+
+#define LTI_FFT_TOL 1e-7 // The impulse responses of the LTI_FFT filter are truncated where they fall below LTI_FFT_TOL times their peak
+#define LTI_FFT_MAX_NFFT 65536 // Largest FFT size of the LTI_FFT filter (twice the longest impulse response)
+
+///////////////////////////////////////////
+//   DATA STRUCTURES
+///////////////////////////////////////////
+
+// State of a 1st-order IIR filter (last input and output samples)
+typedef struct {
+    float   x1;
+    float   y1;
+} iir1_state_t;
+
+// State of a 2nd-order IIR filter (two last input and output samples)
+typedef struct {
+    float   x1;
+    float   x2;
+    float   y1;
+    float   y2;
+} iir2_state_t;
+
+// State of a 2nd-order IIR filter in delta-operator form (the two integrators)
+typedef struct {
+    float   s1;
+    float   s2;
+} iir2_delta_state_t;
+
+// State of a 2nd-order fixed-point IIR filter (two last input samples, two last outputs with DFILT_STATE_FRAC fractional bits)
+typedef struct {
+    int64_t x1;
+    int64_t x2;
+    int64_t y1;
+    int64_t y2;
+} iir2_fixed_state_t;
+
+// State of a counter-based random number generator (Philox4x32-10), one per independent noise stream
+// draw n of a stream is word n % 4 of block n / 4, the encryption of the counter (n / 4, stream) with the key
+typedef struct {
+    uint32_t    key[2];     // from the seed of the run
+    uint32_t    stream[2];  // high words of the counter: buffer index, then subject index and noise source
+    uint64_t    next;       // index of the next draw
+    uint64_t    block;      // index of the block held in out, UINT64_MAX if none
+    uint32_t    out[4];
+} rng_t;
+
+// State of a pink noise generator (Voss-McCartney sources)
+typedef struct {
+    float   sources[PINK_NOISE_NSOURCES];
+    float   running_sum;
+    float   source_scale;   // standard deviation of the sources, 0 if not initialized
+    int     key;
+} pink_state_t;
+
+// State of a noise synthesis (NOISE_SYNTH): each inverse FFT of a shaped random spectrum gives two independent frames (real and
+// imaginary parts), played one after the other and crossfaded over NOISE_SYNTH_NFADE samples
+typedef struct {
+    float*  re;         // NOISE_SYNTH_NFFT, frames of the last inverse FFT
+    float*  im;         // NOISE_SYNTH_NFFT
+    float*  amp;        // NOISE_SYNTH_NFFT, standard deviation of the real and imaginary parts of each bin, in bit-reversed order
+    float*  tw_re;      // NOISE_SYNTH_NFFT
+    float*  tw_im;      // NOISE_SYNTH_NFFT
+    float*  fade;       // NOISE_SYNTH_NFADE, fade-in gains (fade-out gains in reverse order)
+    float*  tail;       // NOISE_SYNTH_NFADE, end of the previous frame
+    int     frame;      // frame played: 0 real part, 1 imaginary part, -1 none (after noise_synth_reset)
+    int     pos;        // next sample of the frame played
+    int     fading;     // 1 if the frame played starts with a crossfade from tail
+} noise_synth_t;
+
+// Noise bank mapped by a context (NOISE_BANK): per noise source, rings of unit white and pink noise read at a position
+typedef struct {
+    void*           map;                        // mapping of the bank file, NULL if not open
+    size_t          map_size;
+    const float*    white[N_RNG_STREAMS];       // unit gaussian noise, per source (RNG_STREAM_*)
+    const float*    pink[N_RNG_STREAMS];        // Voss-McCartney noise of unit sources
+    int64_t         nsamples;                   // samples of each ring, config.noise_bank_nbuffers buffers at the analog rate
+    int64_t         pos[N_RNG_STREAMS];         // next sample read in each ring
+    float           white_scale[N_RNG_STREAMS]; // scales of the configuration (see mixed_noise_scales)
+    float           pink_scale[N_RNG_STREAMS];
+} noise_bank_t;
+
+// Filter and noise states of the module chain, carried from one chunk to the next
+typedef struct {
+    iir1_state_t    pcb[4]; // in1d, in2d, in1c, in2c
+    iir1_state_t    ia;
+    iir2_state_t    afilt_hpf;
+    iir2_state_t    afilt_lpf;
+    iir2_delta_state_t  afilt_hpf_delta;    // IIR_DELTA only
+    iir2_delta_state_t  afilt_lpf_delta;
+    iir2_state_t    dfilt_hpf;
+    iir2_state_t    dfilt_lpf;
+    iir2_fixed_state_t  dfilt_hpf_fixed;    // DFILT_FIXED only
+    iir2_fixed_state_t  dfilt_lpf_fixed;
+    pink_state_t    cm_pink[2]; // in1c, in2c
+    pink_state_t    ia_pink;
+} chain_state_t;
+
+// Polyphase interpolator of the experimental data to the analog rate (see interp_design)
+typedef struct {
+    int     ratio;      // output samples per input sample (ctx->input_ratio)
+    int     ntaps;      // taps per phase, 2 for INTERP_LINEAR
+    int     delay;      // delay of the filter in inputs, compensated by reading as many inputs ahead (0 for INTERP_LINEAR)
+    float   coefs[INTERP_NTAPS_MAX * INPUT_FS_RATIO]; // coefs[t * ratio + k]: weight of the t-th input (oldest first) in phase k
+} interp_t;
+
+// State of an interpolator: last input samples (oldest first), zeroed at the beginning of a buffer
+typedef struct {
+    float   hist[INTERP_NTAPS_MAX - 1];
+    double  prev;       // INTERP_DOUBLE only
+} interp_state_t;
+
+// Buffer-level stimuli, from which chunks are produced in stream and continuous modes
+typedef struct {
+    double*     in1;        // experimental data of input 1, up to STIMULI_INPUT_NSAMPLES
+    double*     in2;        // experimental data of input 2, up to STIMULI_INPUT_NSAMPLES
+    int         first_input;    // index in in1 and in2 of the first input of the segment, after those priming the interpolators
+    interp_state_t  in1_interp; // interpolator of input 1, continues from the previous segment
+    interp_state_t  in2_interp; // interpolator of input 2, continues from the previous segment
+    float*      in1c;       // CM noise of input 1, up to N_SAMPLES (at the analog rate)
+    float*      in2c;       // CM noise of input 2, up to N_SAMPLES (at the analog rate)
+} stimuli_buffer_t;
+
+// Scratch memory of a context, allocated once by afe_ctx_init: the modules take their temporaries as slices, released in
+// reverse order, so that no heap allocation is made per buffer (see scratch_alloc)
+typedef struct {
+    char*       base;
+    size_t      size;       // bytes
+    size_t      used;       // bytes taken by the slices in use
+} scratch_t;
+
+// Coefficients of the analog filters at the rate of the analog modules (see afe_ctx_init)
+typedef struct {
+    float   pcb_alpha[2];
+    float   pcb_beta[2];
+    float   ia_alpha[2];
+    float   ia_beta[2];
+    float   afilt_hpf_alpha[3];
+    float   afilt_hpf_beta[3];
+    float   afilt_lpf_alpha[3];
+    float   afilt_lpf_beta[3];
+    float   afilt_hpf_delta[5];     // IIR_DELTA only, see bilinear_order_2_delta
+    float   afilt_lpf_delta[5];
+} analog_coefs_t;
+
+// Coefficients of the digital filters at the ADC rate (see afe_ctx_init), in double for the fixed-point model
+typedef struct {
+    double  hpf_alpha[3];
+    double  hpf_beta[3];
+    double  lpf_alpha[3];
+    double  lpf_beta[3];
+} dfilt_coefs_t;
+
+// Overlap-save FIR filter of the linear path from the PCB to the AFILT LPF (LTI_FFT, see ltiInit)
+typedef struct {
+    int     nfft;       // FFT size, power of 2
+    int     ntaps;      // length of the impulse responses
+    float*  a_re;       // spectrum applied to the FFT of (signal + i*noise), nfft bins in bit-reversed order (see ltiModuleChunk)
+    float*  a_im;
+    float*  b_re;       // spectrum applied to the conjugate mirrored FFT of (signal + i*noise), nfft bins in bit-reversed order
+    float*  b_im;
+    float*  tw_re;      // FFT twiddle factors
+    float*  tw_im;
+    float*  z_re;       // work vectors, nfft
+    float*  z_im;
+    float*  y_re;
+    float*  y_im;
+    float*  hist;       // last ntaps-1 signal samples (state)
+    float*  hist_noise; // last ntaps-1 noise samples (state)
+} lti_fft_t;
+
+// Output vector of the ADC: packed codes (offset binary, 0 to 2^adc_nbits - 1), or one int vector per bit (MSB first) with ADC_BITPLANES
+#ifdef ADC_BITPLANES
+    typedef int** adc_out_t;
+#else
+    typedef uint16_t* adc_out_t;
+#endif // ADC_BITPLANES
+
+// Run-time configuration of a front-end instance, defaults taken from the macros above (see afe_config_default)
+// Fields can be set by name from configuration files and the command line (see afe_config_set)
+typedef struct {
+    const char*     data_folder;        // VENG_DATA_FOLDER
+    const char*     run_folder;         // RUN_FOLDER
+    const char*     run_category;       // RUN_CATEGORY
+    int             chunk_nsamples;     // STREAM_NSAMPLES in stream mode, else N_SAMPLES (the only size without CHUNKED)
+    int             analog_fs_ratio;    // ANALOG_FS_RATIO
+    int             osr_log;            // ADC_OSR_LOG, sets the ADC rate (ctx->adc_fs_ratio), not the output rate
+    uint64_t        seed;               // SEED
+    int             noise_bank_nbuffers; // NOISE_BANK_NBUFFERS
+    double          input_cm;           // INPUT_CM
+    float           ia_gain;            // IA_GAIN
+    float           ia_cmrr;            // IA_CMRR
+    float           ia_noise;           // IA_NOISE
+    float           ia_fcorner;         // IA_FCORNER
+    float           afilt_gain;         // AFILT_GAIN
+    float           afilt_dc_out;       // AFILT_DC_OUT
+    float           afilt_dr_max;       // AFILT_DR_MAX
+    int             afilt_sat_curve;    // AFILT_SAT_CURVE
+    int             adc_nbits;          // ADC_NBITS
+    int             interp_filter;      // INPUT_INTERP
+    int             interp_ntaps;       // INTERP_NTAPS
+    double          pcb_fl;             // PCB_FL
+    double          ia_fh;              // IA_FH
+    double          afilt_fl1;          // AFILT_FL1
+    double          afilt_fl2;          // AFILT_FL2
+    double          afilt_fh;           // AFILT_FH
+    double          dfilt_fl;           // DFILT_FL
+    double          dfilt_fh;           // DFILT_FH
+} afe_config_t;
+
+// Timings of one buffer (PROFILE)
+typedef struct {
+    double      seconds[N_STAGES];      // wall time spent in each stage
+    int64_t     nsamples[N_STAGES];     // samples at the input of each stage
+    int64_t     nsignal;                // samples of signal simulated, at FS
+} profile_buffer_t;
+
+// Timings of a run, shared by the contexts of the worker threads (each buffer is timed by one thread at a time)
+typedef struct {
+    profile_buffer_t*   buffers;        // NSUBJECTS * N_BUFFERS, buffer b of subject s at s * N_BUFFERS + b
+    char*               done;           // buffers timed, per buffer
+    double              wall_seconds;   // elapsed time of the run
+    int                 nthreads;
+} profile_t;
+
+// Simulation context of one front-end instance: configuration, random number generators, states and vectors of the module chain
+// Contexts share no data, so that several instances can run in one process (e.g. one per worker thread)
+typedef struct {
+    afe_config_t        config;
+    int                 analog_fs;          // rate of the analog modules, FS / config.analog_fs_ratio
+    int                 analog_nsamples;    // samples in a buffer at analog_fs
+    int                 input_ratio;        // oversampling of the experimental data to analog_fs
+    int                 adc_fs_ratio;       // FS / ADC rate, OUT_FS_RATIO >> config.osr_log
+    int                 adc_nsamples;       // ADC samples in a buffer, N_SAMPLES / adc_fs_ratio
+    int                 adc_stride;         // distance between two ADC samples at analog_fs
+    analog_coefs_t      analog_coefs;       // at analog_fs
+    dfilt_coefs_t       dfilt_coefs;        // at the ADC rate, FS / adc_fs_ratio
+    interp_t            interp;             // experimental data to analog_fs
+    rng_t               rng[N_RNG_STREAMS]; // one stream per noise source (RNG_STREAM_*)
+    chain_state_t       chain_state;
+    float*              in1d;
+    float*              in2d;
+    float*              in1c;
+    float*              in2c;
+    float*              pcbOut1d;
+    float*              pcbOut2d;
+    float*              pcbOut1c;
+    float*              pcbOut2c;
+    float*              iaOut;
+    float*              afiltOutp;
+    float*              afiltOutn;
+    adc_out_t           adcOut;             // chunk_nsamples / adc_fs_ratio codes (or bits)
+    int*                dfiltOut;           // DECIM_UNFUSED only
+    int*                out;                // always OUT_NSAMPLES
+    stimuli_buffer_t    stimuli_buffer;     // stream and continuous modes only
+    float*              iaNoise;            // N_SAMPLES, NOISY only
+    lti_fft_t           lti;                // LTI_FFT only
+    noise_synth_t       noise_synth[N_RNG_STREAMS]; // NOISE_SYNTH only, per noise source (RNG_STREAM_*)
+    noise_bank_t        noise_bank;         // NOISE_BANK only, mapped by each context
+    scratch_t           scratch;            // temporaries of the modules, sized by afe_ctx_init
+    int                 nbuffers_run;       // buffers run by the context, the first one warms up (ALLOC_COUNT)
+    profile_t*          profile;            // PROFILE only, timings of the run (NULL if not timed)
+} afe_ctx_t;
 
 // Look-up table for IIR filter coefficients
 #include "./filt_lookup.h"
@@ -8,24 +8,108 @@
     @brief      module to generate the stimuli
                 in1d and in2d come from the experimental data stored in overlapping buffers
                 in1c and in2c is noise generated according to parameters specified in setup.h
+                all vectors hold ctx->analog_nsamples samples at the rate of the analog modules
+                with COLLAPSE_LINEAR, in1d and in1c hold the averages of the two inputs, in2d and in2c are unused
     @param[out] in1d        points to the vector of input 1 differential mode
     @param[out] in2d        points to the vector of input 2 differential mode  
     @param[out] in1c        points to the vector of input 1 common mode
     @param[out] in2c        points to the vector of input 2 common mode  
     @param[in]  buffer_idx  index of the considered buffer
     @param[in]  subject     points to the name of the considered subject
+    @param[in,out] ctx      points to the simulation context (configuration, noise states zeroed by afe_ctx_reset for a new buffer,
+                            random number generator)
     @return     1 if error during file reading, else 0
 */
-int stimuliModule(float* in1d, float* in2d, float* in1c, float* in2c, int buffer_idx, char* subject);
+int stimuliModule(float* in1d, float* in2d, float* in1c, float* in2c, int buffer_idx, char* subject, afe_ctx_t* ctx);
 
 /**
-    @brief  reads a file containing the input data buffer and oversamples the signal
+    @brief      generates the CM stimuli of both inputs, as 1/f noise
+    @param[out] in1c        points to the vector of input 1 common mode
+    @param[out] in2c        points to the vector of input 2 common mode
+    @param[in]  size        number of samples to generate, at the rate of the analog modules
+    @param[in,out] ctx      points to the simulation context (configuration, pink noise generators and random number generator)
+    @return     0
+*/
+int cm_noise_generator(float* in1c, float* in2c, int size, afe_ctx_t* ctx);
+
+/**
+    @brief  reads a file containing the input data buffer and oversamples the signal, compensating the delay of the interpolator
+    @param[in]  filename    points to the name of the file
+    @param[out] signal      points to the signal vector, size interp->ratio*INPUT_NSAMPLES
+    @param[out] staging     points to a vector of INPUT_NSAMPLES doubles in which the file is read
+    @param[in]  interp      points to the interpolator (see interp_design)
+    @param[in,out] state    points to the interpolator state, zeroed for a new buffer
+    @return     1 if error during file reading, else 0
+
+*/
+int read_input_ffile(char* filename, float* signal, double* staging, const interp_t* interp, interp_state_t* state);
+
+/**
+    @brief  reads part of a file containing the input data buffer, without oversampling
     @param[in]  filename    points to the name of the file
-    @param[out] signal      points to the signal vector
+    @param[out] signal      points to the signal vector, size size
+    @param[in]  offset      index of the first sample to read (at FS/INPUT_FS_RATIO)
+    @param[in]  size        number of samples to read
+    @return     1 if error during file reading, else 0
+*/
+int read_input_dfile(char* filename, double* signal, int offset, int size);
+
+/**
+    @brief      designs the polyphase interpolator of the experimental data to the analog rate
+                INTERP_LINEAR: linear interpolation between consecutive inputs (2 taps per phase)
+                INTERP_SINC: Blackman-windowed sinc at the input Nyquist frequency, ntaps per phase normalized to unit DC gain,
+                delayed by ntaps/2-1 inputs (interp->delay), compensated by the readers of the inputs, which prime the history
+                with the first interp->delay inputs and then read as many inputs ahead
+    @param[out] interp      points to the interpolator
+    @param[in]  ratio       oversampling ratio, divides INPUT_FS_RATIO (INPUT_FS_RATIO to reach FS)
+                            below FS, the samples are aligned with the samples read at FS
+    @param[in]  filter      INTERP_LINEAR or INTERP_SINC (only INTERP_LINEAR with INTERP_DOUBLE)
+    @param[in]  ntaps       taps per phase of INTERP_SINC, even, up to INTERP_NTAPS_MAX (ignored by INTERP_LINEAR)
+    @return     1 if the filter or the number of taps is invalid, else 0
+*/
+int interp_design(interp_t* interp, int ratio, int filter, int ntaps);
+
+/**
+    @brief      converts the input data to float and oversamples it by interp->ratio, by tiles of INTERP_TILE_NSAMPLES inputs
+                in float, all phases of an input computed at once (vectorized), or in double with INTERP_DOUBLE (reference,
+                linear interpolation only, equal to the float version within float rounding)
+    @param[in]      signal_in       points to the input data vector
+    @param[out]     signal_out      points to the oversampled vector, size interp->ratio*size
+    @param[in]      size            number of samples in the input data vector
+    @param[in]      interp          points to the interpolator (see interp_design)
+    @param[in,out]  state           points to the interpolator state (inputs before signal_in), updated at the end
+    @return     0
+*/
+int oversample_input(double* signal_in, float* signal_out, int size, const interp_t* interp, interp_state_t* state);
+
+/**
+    @brief      prepares a segment of a buffer for stream and continuous modes: reads the experimental data and generates
+                the CM noise for the whole segment (same random draws as stimuliModule for a full buffer with a zeroed state)
+                into ctx->stimuli_buffer
+    @param[in]  buffer_idx  index of the considered buffer
+    @param[in]  subject     points to the name of the considered subject
+    @param[in]  offset      index of the first sample of the segment in the buffer (at FS), multiple of INPUT_FS_RATIO
+                            if 0, the oversampling restarts from 0, otherwise it continues from the previous segment
+                            the inputs are read ctx->interp.delay samples ahead (see interp_design)
+    @param[in]  size        number of samples in the segment (at FS), multiple of INPUT_FS_RATIO
+                            the CM noise holds size/config.analog_fs_ratio samples at the rate of the analog modules
+    @param[in,out] ctx      points to the simulation context (buffer-level stimuli, pink noise generators, random number generator)
     @return     1 if error during file reading, else 0
+*/
+int stimuliLoadBuffer(int buffer_idx, char* subject, int offset, int size, afe_ctx_t* ctx);
 
+/**
+    @brief      produces the differential-mode stimuli of a chunk from a buffer prepared with stimuliLoadBuffer
+                the CM stimuli of the chunk are read directly from ctx->stimuli_buffer.in1c and ctx->stimuli_buffer.in2c,
+                at offset/config.analog_fs_ratio
+    @param[in]  offset      index of the first sample of the chunk in the segment (at FS), multiple of INPUT_FS_RATIO
+    @param[in]  size        number of samples in the chunk (at FS), multiple of INPUT_FS_RATIO
+    @param[out] in1d        points to the vector of input 1 differential mode, size/config.analog_fs_ratio samples
+    @param[out] in2d        points to the vector of input 2 differential mode, size/config.analog_fs_ratio samples
+    @param[in,out] ctx      points to the simulation context (buffer-level stimuli)
+    @return     0
 */
-int read_input_ffile(char* filename, float* signal);
+int stimuliModuleChunk(int offset, int size, float* in1d, float* in2d, afe_ctx_t* ctx);
 
 
 
@@ -42,6 +42,440 @@ int iir_order_2(float* sig_in, float* sig_out, int size, float* alpha, float* be
 */
 int iir_order_2_int(int* sig_in, int* sig_out, int size, float* alpha, float* beta);
 
+/**
+    @brief          same as iir_order_1, but starts from the given filter state and updates it at the end
+                    (the output is identical to a single call on the concatenated chunks)
+    @param[in]      sig_in      points to the input vector
+    @param[out]     sig_out     points to the output vector (can be the same as sig_in)
+    @param[in]      size        number of samples in the input vector
+    @param[in]      alpha       points to the vector of alpha coefficients (numerator), size 2
+    @param[in]      beta        points to the vector of beta coefficients (denominator), size 2
+    @param[in,out]  state       points to the filter state
+	@return			0
+*/
+int iir_order_1_chunk(float* sig_in, float* sig_out, int size, float* alpha, float* beta, iir1_state_t* state);
+
+/**
+    @brief          same as iir_order_2, but starts from the given filter state and updates it at the end
+    @param[in]      sig_in      points to the input vector
+    @param[out]     sig_out     points to the output vector (can be the same as sig_in)
+    @param[in]      size        number of samples in the input vector
+    @param[in]      alpha       points to the vector of alpha coefficients (numerator), size 3
+    @param[in]      beta        points to the vector of beta coefficients (denominator), size 3
+    @param[in,out]  state       points to the filter state
+	@return			0
+*/
+int iir_order_2_chunk(float* sig_in, float* sig_out, int size, float* alpha, float* beta, iir2_state_t* state);
+
+/**
+    @brief          same as iir_order_2_int, but starts from the given filter state and updates it at the end
+                    (the state keeps the unrounded outputs, as in iir_order_2_int)
+    @param[in]      sig_in      points to the input vector (int)
+    @param[out]     sig_out     points to the output vector (int, can be the same as sig_in)
+    @param[in]      size        number of samples in the input vector
+    @param[in]      alpha       points to the vector of alpha coefficients (numerator), size 3
+    @param[in]      beta        points to the vector of beta coefficients (denominator), size 3
+    @param[in,out]  state       points to the filter state
+	@return			0
+*/
+int iir_order_2_int_chunk(int* sig_in, int* sig_out, int size, float* alpha, float* beta, iir2_state_t* state);
+
+/**
+    @brief          same as iir_order_2_chunk with the delta-operator form of the filter, delta = {n0, n1, n2, d1, d2} for
+                        H = (n0*r^2 + n1*r + n2) / (r^2 + d1*r + d2), with r = z - 1 (see bilinear_order_2_delta)
+                    transposed structure with two integrators, evaluated in float:
+                        y[n] = n0*x[n] + s1,  s1 += n1*x[n] - d1*y[n] + s2,  s2 += n2*x[n] - d2*y[n]
+                    with poles close to z = 1, d1 and d2 are small and keep their full relative precision in float, whereas
+                    alpha[1] and alpha[2] lose their distance to -2 and 1 (the 7 Hz AFILT HPF pole at 640 kS/s), so that the
+                    output stays within 1e-6 of a double filter where the direct form drifts by several percent
+    @param[in]      sig_in      points to the input vector
+    @param[out]     sig_out     points to the output vector (can be the same as sig_in)
+    @param[in]      size        number of samples in the input vector
+    @param[in]      delta       points to the vector of delta-operator coefficients, size 5
+    @param[in,out]  state       points to the filter state
+	@return			0
+*/
+int iir_order_2_delta_chunk(float* sig_in, float* sig_out, int size, float* delta, iir2_delta_state_t* state);
+
+/**
+    @brief          same as iir_order_1_chunk on nstreams independent streams stored interleaved (sample i of stream k at i*nstreams + k)
+                    streams are filtered together in SIMD lanes (groups of 8, then 4, then one by one),
+                    each stream gives the same output as iir_order_1_chunk
+    @param[in]      sig_in      points to the interleaved input vector, size nstreams*size
+    @param[out]     sig_out     points to the interleaved output vector (can be the same as sig_in)
+    @param[in]      nstreams    number of streams
+    @param[in]      size        number of samples per stream
+    @param[in]      alpha       points to the alpha coefficients of all streams, size 2*nstreams (stream k at alpha + 2*k)
+    @param[in]      beta        points to the beta coefficients of all streams, size 2*nstreams (stream k at beta + 2*k)
+    @param[in,out]  states      points to the filter states of all streams, size nstreams
+	@return			0
+*/
+int iir_order_1_streams(float* sig_in, float* sig_out, int nstreams, int size, float* alpha, float* beta, iir1_state_t* states);
+
+/**
+    @brief          same as iir_order_2_chunk on nstreams independent streams stored interleaved (see iir_order_1_streams)
+    @param[in]      sig_in      points to the interleaved input vector, size nstreams*size
+    @param[out]     sig_out     points to the interleaved output vector (can be the same as sig_in)
+    @param[in]      nstreams    number of streams
+    @param[in]      size        number of samples per stream
+    @param[in]      alpha       points to the alpha coefficients of all streams, size 3*nstreams (stream k at alpha + 3*k)
+    @param[in]      beta        points to the beta coefficients of all streams, size 3*nstreams (stream k at beta + 3*k)
+    @param[in,out]  states      points to the filter states of all streams, size nstreams
+	@return			0
+*/
+int iir_order_2_streams(float* sig_in, float* sig_out, int nstreams, int size, float* alpha, float* beta, iir2_state_t* states);
+
+/**
+    @brief          same as iir_order_1_chunk, computed by blocks of IIR_BLOCK_NSAMPLES samples with the block state-space form
+                    y[block] = G * x[block] + F * state, where G and F are precomputed from powers of the state matrix
+                    (the recursion only runs from block to block, all other operations are SIMD multiply-adds)
+                    used by iir_order_1_chunk if IIR_BLOCK is defined
+                    not bit-exact, but computed in double: measured against a double-precision serial reference on the
+                    PCB and IA filters (640k samples), the error stays below 1.1e-7 of the output RMS, i.e. the output rounding
+                    (serial float filter: up to 2.3e-6)
+    @param[in]      sig_in      points to the input vector
+    @param[out]     sig_out     points to the output vector (can be the same as sig_in)
+    @param[in]      size        number of samples in the input vector
+    @param[in]      alpha       points to the vector of alpha coefficients (numerator), size 2
+    @param[in]      beta        points to the vector of beta coefficients (denominator), size 2
+    @param[in,out]  state       points to the filter state
+	@return			0
+*/
+int iir_order_1_block(float* sig_in, float* sig_out, int size, float* alpha, float* beta, iir1_state_t* state);
+
+/**
+    @brief          same as iir_order_2_chunk, computed by blocks with the block state-space form (see iir_order_1_block)
+                    used by iir_order_2_chunk if IIR_BLOCK is defined
+                    measured against a double-precision serial reference on the AFILT and DFILT filters, the error stays
+                    below 1.3e-7 of the output RMS (serial float filter: up to 3.8e-2 for the AFILT HPF, whose poles are close to 1)
+                    by chunks, the state is rounded to float at each call: up to 8e-4 for the AFILT HPF with chunks of a few samples
+                    (checked by make test, see test/iir_test.c)
+    @param[in]      sig_in      points to the input vector
+    @param[out]     sig_out     points to the output vector (can be the same as sig_in)
+    @param[in]      size        number of samples in the input vector
+    @param[in]      alpha       points to the vector of alpha coefficients (numerator), size 3
+    @param[in]      beta        points to the vector of beta coefficients (denominator), size 3
+    @param[in,out]  state       points to the filter state
+	@return			0
+*/
+int iir_order_2_block(float* sig_in, float* sig_out, int size, float* alpha, float* beta, iir2_state_t* state);
+
+/**
+    @brief          same as iir_order_2_int_chunk, computed by blocks with the block state-space form (see iir_order_1_block)
+                    used by iir_order_2_int_chunk if IIR_BLOCK is defined
+                    measured on ADC-like codes against a rounded double-precision serial reference, the outputs are within
+                    1.3 LSB with the DFILT filters (serial filter: up to 45 LSB with the DFILT HPF)
+    @param[in]      sig_in      points to the input vector (int)
+    @param[out]     sig_out     points to the output vector (int, can be the same as sig_in)
+    @param[in]      size        number of samples in the input vector
+    @param[in]      alpha       points to the vector of alpha coefficients (numerator), size 3
+    @param[in]      beta        points to the vector of beta coefficients (denominator), size 3
+    @param[in,out]  state       points to the filter state
+	@return			0
+*/
+int iir_order_2_int_block(int* sig_in, int* sig_out, int size, float* alpha, float* beta, iir2_state_t* state);
+
+/**
+    @brief          same as iir_order_1_streams on streams stored in separate vectors, interleaved tile by tile on the stack
+                    (no allocation, the interleaved tiles stay in L1 cache)
+    @param[in]      sig_in      points to the nstreams input vectors
+    @param[out]     sig_out     points to the nstreams output vectors (can be the same as sig_in)
+    @param[in]      nstreams    number of streams, up to IIR_TILE_NFLOATS
+    @param[in]      size        number of samples per stream
+    @param[in]      alpha       points to the alpha coefficients of all streams, size 2*nstreams
+    @param[in]      beta        points to the beta coefficients of all streams, size 2*nstreams
+    @param[in,out]  states      points to the filter states of all streams, size nstreams
+	@return			0
+*/
+int iir_order_1_multi(float** sig_in, float** sig_out, int nstreams, int size, float* alpha, float* beta, iir1_state_t* states);
+
+/**
+    @brief          same as iir_order_2_streams on streams stored in separate vectors (see iir_order_1_multi)
+    @param[in]      sig_in      points to the nstreams input vectors
+    @param[out]     sig_out     points to the nstreams output vectors (can be the same as sig_in)
+    @param[in]      nstreams    number of streams, up to IIR_TILE_NFLOATS
+    @param[in]      size        number of samples per stream
+    @param[in]      alpha       points to the alpha coefficients of all streams, size 3*nstreams
+    @param[in]      beta        points to the beta coefficients of all streams, size 3*nstreams
+    @param[in,out]  states      points to the filter states of all streams, size nstreams
+	@return			0
+*/
+int iir_order_2_multi(float** sig_in, float** sig_out, int nstreams, int size, float* alpha, float* beta, iir2_state_t* states);
+
+/**
+    @brief          interleaves nstreams vectors (sample i of stream k to out[i*nstreams + k])
+    @param[in]      in          points to the nstreams input vectors
+    @param[out]     out         points to the interleaved vector, size nstreams*size
+    @param[in]      nstreams    number of streams
+    @param[in]      size        number of samples per stream
+	@return			0
+*/
+int interleave_streams(float** in, float* out, int nstreams, int size);
+
+/**
+    @brief          splits an interleaved vector into nstreams vectors (inverse of interleave_streams)
+    @param[in]      in          points to the interleaved vector, size nstreams*size
+    @param[out]     out         points to the nstreams output vectors
+    @param[in]      nstreams    number of streams
+    @param[in]      size        number of samples per stream
+	@return			0
+*/
+int deinterleave_streams(float* in, float** out, int nstreams, int size);
+
+
+
+
+///////////////////////////////////////////
+//   Fixed-point arithmetic
+///////////////////////////////////////////
+
+/**
+    @brief          shifts a fixed-point value right, dropping its shift lowest bits
+    @param[in]      v           value
+    @param[in]      shift       number of bits dropped, from 0 to 62
+    @param[in]      rounding    0 for truncation (toward -inf), 1 for rounding to nearest (half up)
+	@return			shifted value
+*/
+static inline int64_t fixed_shift(int64_t v, int shift, int rounding) {
+
+    if (rounding && shift > 0) {
+        v += (int64_t)1 << (shift - 1);
+    }
+    return v >> shift;
+}
+
+/**
+    @brief          brings a value within the range of a two's complement word
+    @param[in]      v           value
+    @param[in]      bits        width of the word, from 2 to 63
+    @param[in]      saturation  0 for wrap-around (modulo 2^bits), 1 for saturation to the extreme values
+	@return			value within the word
+*/
+static inline int64_t fixed_overflow(int64_t v, int bits, int saturation) {
+
+    int64_t vmax = ((int64_t)1 << (bits - 1)) - 1;
+    if (saturation) {
+        return (v > vmax) ? vmax : ((v < -vmax - 1) ? -vmax - 1 : v);
+    }
+    return (int64_t)((uint64_t)v << (64 - bits)) >> (64 - bits);
+}
+
+/**
+    @brief          quantizes the coefficients of a 2nd-order IIR filter (normalized by alpha[0]) with frac fractional bits
+    @param[in]      alpha       points to the vector of alpha coefficients, size 3
+    @param[in]      beta        points to the vector of beta coefficients, size 3
+    @param[in]      frac        number of fractional bits
+    @param[out]     alpha_fixed points to the vector of quantized alpha coefficients, size 3
+    @param[out]     beta_fixed  points to the vector of quantized beta coefficients, size 3
+	@return			0
+*/
+int iir_order_2_fixed_coefs(double* alpha, double* beta, int frac, int64_t* alpha_fixed, int64_t* beta_fixed);
+
+/**
+    @brief          applies 2nd-order IIR filtering in fixed point (direct form I), bit-true model of the digital filters:
+                    - coefficients with DFILT_COEF_FRAC fractional bits (see iir_order_2_fixed_coefs)
+                    - sum of the products in a DFILT_ACC_BITS accumulator, shifted back with DFILT_ROUNDING
+                    - recursive outputs kept with DFILT_STATE_FRAC fractional bits, within OUT_NBITS integer bits
+                    - outputs rounded to integers within OUT_NBITS bits
+                    overflows follow DFILT_SATURATION, applied to the complete sum of the accumulator (exact for wrap-around)
+                    the feed-forward products are computed ahead by tiles of IIR_TILE_NFLOATS samples (vectorized with
+                    64-bit SIMD multiplies, e.g. SIMD_FLAGS=-mavx2), only the feedback is serial
+    @param[in]      sig_in      points to the input vector (int, within OUT_NBITS bits)
+    @param[out]     sig_out     points to the output vector (int, can be the same as sig_in)
+    @param[in]      size        number of samples in the input vector
+    @param[in]      alpha       points to the vector of quantized alpha coefficients, size 3 (alpha[0] unused, 1)
+    @param[in]      beta        points to the vector of quantized beta coefficients, size 3
+    @param[in,out]  state       points to the filter state
+	@return			0
+*/
+int iir_order_2_fixed_chunk(int* sig_in, int* sig_out, int size, int64_t* alpha, int64_t* beta, iir2_fixed_state_t* state);
+
+
+
+
+///////////////////////////////////////////
+//   Filter design
+///////////////////////////////////////////
+
+/**
+    @brief          computes the coefficients of a 1st-order IIR filter from the analog prototype (b[0]*s + b[1]) / (a[0]*s + a[1])
+                    with the bilinear transform, without prewarping (as the look-up tables of filt_lookup.h)
+    @param[in]      b           points to the numerator of the analog prototype, size 2
+    @param[in]      a           points to the denominator of the analog prototype, size 2
+    @param[in]      fs          sampling rate in Hz
+    @param[out]     alpha       points to the vector of alpha coefficients (alpha[0] = 1), size 2
+    @param[out]     beta        points to the vector of beta coefficients, size 2
+	@return			0
+*/
+int bilinear_order_1(double* b, double* a, double fs, float* alpha, float* beta);
+
+/**
+    @brief          same as bilinear_order_1 for the 2nd-order analog prototype (b[0]*s^2 + b[1]*s + b[2]) / (a[0]*s^2 + a[1]*s + a[2])
+    @param[in]      b           points to the numerator of the analog prototype, size 3
+    @param[in]      a           points to the denominator of the analog prototype, size 3
+    @param[in]      fs          sampling rate in Hz
+    @param[out]     alpha       points to the vector of alpha coefficients (alpha[0] = 1), size 3
+    @param[out]     beta        points to the vector of beta coefficients, size 3
+	@return			0
+*/
+int bilinear_order_2(double* b, double* a, double fs, float* alpha, float* beta);
+
+/**
+    @brief          same as bilinear_order_2 with the coefficients in double (e.g. for the fixed-point digital filters)
+    @param[in]      b           points to the numerator of the analog prototype, size 3
+    @param[in]      a           points to the denominator of the analog prototype, size 3
+    @param[in]      fs          sampling rate in Hz
+    @param[out]     alpha       points to the vector of alpha coefficients (alpha[0] = 1), size 3
+    @param[out]     beta        points to the vector of beta coefficients, size 3
+	@return			0
+*/
+int bilinear_order_2_double(double* b, double* a, double fs, double* alpha, double* beta);
+
+/**
+    @brief          same as bilinear_order_2, with the coefficients of the delta-operator form (see iir_order_2_delta_chunk)
+                    computed from the analog prototype without cancellation, e.g. d2 = 1 + alpha[1] + alpha[2] = 4*a[2] / a0,
+                    so that no hand-derived offsets are needed for low cutoffs
+    @param[in]      b           points to the numerator of the analog prototype, size 3
+    @param[in]      a           points to the denominator of the analog prototype, size 3
+    @param[in]      fs          sampling rate in Hz
+    @param[out]     delta       points to the vector of delta-operator coefficients {n0, n1, n2, d1, d2}, size 5
+	@return			0
+*/
+int bilinear_order_2_delta(double* b, double* a, double fs, float* delta);
+
+
+
+
+///////////////////////////////////////////
+//   FFT
+///////////////////////////////////////////
+
+/**
+    @brief          computes the twiddle factors of a radix-2 FFT, stored stage by stage (exp(-i*pi*j/h) at index h + j,
+                    for h = 1, 2, 4, ..., n/2 and j < h) so that each stage reads them contiguously
+    @param[out]     tw_re       points to the vector of real parts, size n
+    @param[out]     tw_im       points to the vector of imaginary parts, size n
+    @param[in]      n           FFT size, power of 2 from 4
+	@return			1 if n is not a power of 2 from 4, else 0
+*/
+int fft_init(float* tw_re, float* tw_im, int n);
+
+/**
+    @brief          computes the forward complex FFT of a vector in place (radix 2, decimation in frequency)
+                    the spectrum is left in bit-reversed order: convolutions multiply spectra in that order and go back with
+                    fft_inverse, without any permutation (bin -k of the bin at index p in [h, 2h) is at index 3h-1-p)
+    @param[in,out]  re          points to the vector of real parts, size n
+    @param[in,out]  im          points to the vector of imaginary parts, size n
+    @param[in]      n           FFT size, power of 2 from 4
+    @param[in]      tw_re       points to the real parts of the twiddle factors (see fft_init)
+    @param[in]      tw_im       points to the imaginary parts of the twiddle factors (see fft_init)
+	@return			0
+*/
+int fft_forward(float* restrict re, float* restrict im, int n, const float* restrict tw_re, const float* restrict tw_im);
+
+/**
+    @brief          computes the inverse complex FFT of a spectrum in bit-reversed order in place (radix 2, decimation in time),
+                    back to natural order, not scaled by 1/n
+    @param[in,out]  re          points to the vector of real parts, size n
+    @param[in,out]  im          points to the vector of imaginary parts, size n
+    @param[in]      n           FFT size, power of 2 from 4
+    @param[in]      tw_re       points to the real parts of the twiddle factors (see fft_init)
+    @param[in]      tw_im       points to the imaginary parts of the twiddle factors (see fft_init)
+	@return			0
+*/
+int fft_inverse(float* restrict re, float* restrict im, int n, const float* restrict tw_re, const float* restrict tw_im);
+
+
+
+
+///////////////////////////////////////////
+//   Saturation curves
+///////////////////////////////////////////
+
+/**
+    @brief          applies a memoryless compression curve y = vsat * f(x / vsat) in place, f odd with f'(0) = 1 and |f| <= 1
+                    (SAT_CURVE_SINE, SAT_CURVE_TANH or SAT_CURVE_PIECEWISE, see setup.h)
+                    branchless and vectorized: clipping with fminf/fmaxf, sine and exponential as minimax polynomials,
+                    within 3e-7 * vsat of the exact curves, i.e. 5e-4 ADC LSB for the AFILT
+                    with SAT_LIBM, libm functions and the reference clipping branches instead
+    @param[in,out]  x           points to the vector of the signal
+    @param[in]      size        number of samples
+    @param[in]      vsat        saturation value
+    @param[in]      curve       compression curve
+	@return			1 if the curve is unknown, else 0
+*/
+int saturate(float* x, int size, float vsat, int curve);
+
+
+
+
+///////////////////////////////////////////
+//   Random number generation
+///////////////////////////////////////////
+
+/**
+    @brief      seeds a counter-based random number generator (Philox4x32-10): the key comes from the seed of the run and the
+                counter from the stream indices, so that each (seed, subject, buffer, source) gives an independent sequence
+                that does not depend on the order in which the streams are drawn
+    @param[out] rng     points to the random number generator state
+    @param[in]  seed    seed of the whole run
+    @param[in]  subject index of the subject (below 2^24)
+    @param[in]  buffer  index of the buffer, RNG_BUFFER_ALL for a whole recording
+    @param[in]  source  noise source, i.e. stage and channel (RNG_STREAM_*, below 256)
+    @return     0
+*/
+int rng_seed(rng_t* rng, uint64_t seed, uint32_t subject, uint32_t buffer, uint32_t source);
+
+/**
+    @brief          moves a random number generator ndraws draws ahead, in O(1) (e.g. to resume a stream at a given sample)
+    @param[in,out]  rng     points to the random number generator state
+    @param[in]      ndraws  number of 32-bit draws skipped
+    @return         0
+*/
+int rng_skip(rng_t* rng, uint64_t ndraws);
+
+/**
+    @brief          encrypts one counter of a random number generator, i.e. draws 4*block to 4*block+3 of its stream
+                    (the counter words are the low and high words of block, then rng->stream), without moving the generator
+    @param[in]      rng     points to the random number generator state (key and stream)
+    @param[in]      block   index of the block, any 64-bit value (the draws only reach the blocks below 2^62)
+    @param[out]     out     points to the 4 output words
+    @return         0
+*/
+int rng_block(const rng_t* rng, uint64_t block, uint32_t* out);
+
+/**
+    @brief          draws a uniformly distributed 32-bit integer
+    @param[in,out]  rng     points to the random number generator state
+    @return         random integer
+*/
+uint32_t rng_uint32(rng_t* rng);
+
+/**
+    @brief          draws a uniformly distributed float in [0, 1), with 24-bit resolution
+    @param[in,out]  rng     points to the random number generator state
+    @return         random float
+*/
+float rng_uniform(rng_t* rng);
+
+/**
+    @brief          draws size uniformly distributed 32-bit integers, the same as size calls of rng_uint32
+                    RNG_BATCH_NBLOCKS blocks are encrypted at once, one per SIMD lane
+    @param[in,out]  rng     points to the random number generator state
+    @param[out]     out     points to the output vector of random integers
+    @param[in]      size    number of draws
+    @return         0
+*/
+int rng_uint32_batch(rng_t* rng, uint32_t* out, int size);
+
+/**
+    @brief          draws size uniformly distributed floats in [0, 1), the same as size calls of rng_uniform (see rng_uint32_batch)
+    @param[in,out]  rng     points to the random number generator state
+    @param[out]     out     points to the output vector of random floats
+    @param[in]      size    number of draws
+    @return         0
+*/
+int rng_uniform_batch(rng_t* rng, float* out, int size);
 
 
 
@@ -50,21 +484,36 @@ int iir_order_2_int(int* sig_in, int* sig_out, int size, float* alpha, float* be
 ///////////////////////////////////////////
 
 /**
-    @brief      generates one unique sample of white gaussian noise using the Box-Muller transform
+    @brief      draws size samples of standard gaussian noise times scale, using both outputs (r cos, r sin) of the Box-Muller
+                transform of each pair of uniforms (the sine output of the last pair is dropped if size is odd)
+                vectorized polynomial approximations of ln, sin and cos (within 2e-7 of libm), or libm with GAUSS_LIBM
+    @param[out] out     points to the output vector of gaussian noise
+    @param[in]  size    number of samples
+    @param[in]  scale   standard deviation of the noise
+    @param[in,out]  rng points to the random number generator state
+    @return     0
+*/
+int gaussian_generator(float* out, int size, float scale, rng_t* rng);
+
+/**
+    @brief      generates one unique sample of white gaussian noise using the Box-Muller transform (see gaussian_generator)
     @param[in]  scale   standard devation of the noise generated
+    @param[in,out]  rng     points to the random number generator state
     @return     white noise sample (float)
 */
-float white_noise_sample_generator(float scale);
+float white_noise_sample_generator(float scale, rng_t* rng);
 
 /**
     @brief      generates a vector of band-illimited white gaussian noise using the Box-Muller transform
 	@param[out]	white_noise		points to the output vector of white gaussian noise
     @param[in]  size   			number of samples in the output vector
+	@param[in]	fs				sampling rate of the noise in Hz, the power is defined at FS (same spectral density at any fs)
 	@param[in]	power			noise power in V^2
 	@param[in]	power_band		points to the vector defining the bandwidth in which the noise power is computed
+    @param[in,out]	rng			points to the random number generator state
     @return     0
 */
-int white_noise_generator(float* white_noise, int size, float power, float* power_band);
+int white_noise_generator(float* white_noise, int size, int fs, float power, float* power_band, rng_t* rng);
 
 /**
 	@brief		generates a vector of band-illimited pink noise using the Voss-McCartney algorithm
@@ -73,9 +522,10 @@ int white_noise_generator(float* white_noise, int size, float power, float* powe
 	@param[in]	size			number of samples in the output vector
 	@param[in]	power			noise power in V^2
 	@param[in]	power_band		points to the vector defining the bandwidth in which the noise power is computed
+	@param[in,out]	rng			points to the random number generator state
 	@return		0	
 */
-int pink_noise_generator(float* pink_noise, int size, float power, float* power_band);
+int pink_noise_generator(float* pink_noise, int size, float power, float* power_band, rng_t* rng);
 
 /**
 	@brief		generates a vector of band-illimited white and pink noise
@@ -84,9 +534,102 @@ int pink_noise_generator(float* pink_noise, int size, float power, float* power_
 	@param[in]	power			noise power in V^2
 	@param[in]	fcorner			noise corner frequency in Hz
 	@param[in]	power_band		points to the vector defining the bandwidth in which the noise power is computed
+	@param[in,out]	rng			points to the random number generator state
 	@return		0	
 */
-int mixed_noise_generator_nsamples(float* noise, float power, float fcorner, float* power_band);
+int mixed_noise_generator_nsamples(float* noise, float power, float fcorner, float* power_band, rng_t* rng);
+
+/**
+	@brief		initializes the state of a pink noise generator (draws the initial value of all sources)
+	@param[out]	state			points to the pink noise generator state
+	@param[in]	nsamples		number of samples for which the noise power is defined
+	@param[in]	power			noise power in V^2
+	@param[in]	power_band		points to the vector defining the bandwidth in which the noise power is computed
+	@param[in,out]	rng			points to the random number generator state
+	@return		0
+*/
+int pink_noise_init(pink_state_t* state, int nsamples, float power, float* power_band, rng_t* rng);
+
+/**
+	@brief		same as pink_noise_generator, but continues from the given generator state (see pink_noise_init)
+	@param[out]	pink_noise		points to the output vector of pink noise
+	@param[in]	size			number of samples in the output vector
+	@param[in,out]	state		points to the pink noise generator state
+	@param[in,out]	rng			points to the random number generator state
+	@return		0
+*/
+int pink_noise_generator_chunk(float* pink_noise, int size, pink_state_t* state, rng_t* rng);
+
+/**
+	@brief		same as mixed_noise_generator_nsamples for a chunk of any size, with noise powers still defined for N_SAMPLES-long buffers
+				the pink noise sources continue from the given state, which is initialized on first use (zeroed state)
+				the pink noise is added to the white noise by stack tiles of NOISE_TILE_NSAMPLES (no heap allocation)
+	@param[out]	noise			points to the output vector of mixed noise
+	@param[in]	size			number of samples in the output vector
+	@param[in]	fs				sampling rate of the noise in Hz, the powers are still defined at FS (same spectral densities)
+	@param[in]	power			noise power in V^2
+	@param[in]	fcorner			noise corner frequency in Hz
+	@param[in]	power_band		points to the vector defining the bandwidth in which the noise power is computed
+	@param[in,out]	state		points to the pink noise generator state
+	@param[in,out]	rng			points to the random number generator state
+	@return		0	
+*/
+int mixed_noise_generator_chunk(float* noise, int size, int fs, float power, float fcorner, float* power_band, pink_state_t* state, rng_t* rng);
+
+/**
+	@brief		scales of the unit noises making up the noise of mixed_noise_generator_chunk, so that
+				white_scale * (unit gaussian noise) + pink_scale * (pink noise of unit sources, see pink_noise_generator_chunk)
+				has the same power and spectrum (see noise_bank_chunk)
+	@param[in]	fs				sampling rate of the noise in Hz, the powers are still defined at FS (same spectral densities)
+	@param[in]	power			noise power in V^2
+	@param[in]	fcorner			noise corner frequency in Hz
+	@param[in]	power_band		points to the vector defining the bandwidth in which the noise power is computed
+	@param[out]	white_scale		standard deviation of the white noise samples
+	@param[out]	pink_scale		standard deviation of the pink noise sources
+	@return		0
+*/
+int mixed_noise_scales(int fs, float power, float fcorner, float* power_band, float* white_scale, float* pink_scale);
+
+/**
+	@brief		allocates and designs a noise synthesis (NOISE_SYNTH), alternative to mixed_noise_generator_chunk: gaussian noise
+				of PSD w * (1 + fcorner / f) from the lowest bin (fs / NOISE_SYNTH_NFFT) to fs / 2, with w such that the bins in
+				the band hold exactly the power
+	@param[out]	synth			points to the noise synthesis state
+	@param[in]	fs				sampling rate of the noise in Hz
+	@param[in]	power			noise power in V^2 in the band
+	@param[in]	fcorner			noise corner frequency in Hz
+	@param[in]	power_band		points to the vector defining the bandwidth in which the noise power is computed, NULL for the
+								whole band up to fs / 2
+	@return		1 if memory allocation failed or no bin is in the band, else 0
+*/
+int noise_synth_init(noise_synth_t* synth, int fs, float power, float fcorner, float* power_band);
+
+/**
+	@brief		frees the vectors of a noise synthesis
+	@param[in,out]	synth		points to the noise synthesis state
+	@return		0
+*/
+int noise_synth_free(noise_synth_t* synth);
+
+/**
+	@brief		restarts a noise synthesis from a new frame, without crossfade (e.g. for a new buffer)
+	@param[in,out]	synth		points to the noise synthesis state
+	@return		0
+*/
+int noise_synth_reset(noise_synth_t* synth);
+
+/**
+	@brief		synthesizes a chunk of noise, continuing the frames of the state: each inverse FFT of NOISE_SYNTH_NFFT bins of
+				independent complex gaussian noise shaped by the PSD gives two frames, which follow each other with a
+				power-complementary crossfade (sin and cos gains) over their last and first NOISE_SYNTH_NFADE samples
+				the output only depends on the samples drawn so far, not on the chunk sizes
+	@param[out]	noise			points to the output vector of noise
+	@param[in]	size			number of samples in the output vector
+	@param[in,out]	synth		points to the noise synthesis state (see noise_synth_init)
+	@param[in,out]	rng			points to the random number generator state
+	@return		0
+*/
+int noise_synth_chunk(float* noise, int size, noise_synth_t* synth, rng_t* rng);
 
 
 
@@ -188,6 +731,60 @@ int write_multiintarray_to_file(int** array, uint32_t nArrays, uint32_t arraySiz
 
 
 
+///////////////////////////////////////////
+//   Memory
+///////////////////////////////////////////
+
+/**
+	@brief		allocates the scratch memory of a context
+	@param[out]	scratch		points to the scratch memory
+	@param[in]	size		number of bytes (slices are rounded up to SCRATCH_ALIGN bytes), can be 0
+	@return		1 if memory allocation failed, else 0
+*/
+int scratch_init(scratch_t* scratch, size_t size);
+
+/**
+	@brief		takes a slice of the scratch memory, aligned on SCRATCH_ALIGN bytes
+	@param[in,out]	scratch	points to the scratch memory
+	@param[in]	size		number of bytes
+	@return		pointer to the slice, NULL if the scratch memory is exhausted (sized too small by afe_ctx_init)
+*/
+void* scratch_alloc(scratch_t* scratch, size_t size);
+
+/**
+	@brief		releases a slice of the scratch memory and all slices taken after it
+	@param[in,out]	scratch	points to the scratch memory
+	@param[in]	slice		pointer returned by scratch_alloc
+	@return		0
+*/
+int scratch_release(scratch_t* scratch, void* slice);
+
+/**
+	@brief		frees the scratch memory of a context
+	@param[in,out]	scratch	points to the scratch memory
+	@return		0
+*/
+int scratch_free(scratch_t* scratch);
+
+#ifdef ALLOC_COUNT
+/**
+	@brief		number of heap allocations (malloc, calloc, realloc) made so far by the calling thread in the sources including
+				this header, which are redirected to counting wrappers (allocations inside the C library are not counted)
+	@return		number of allocations
+*/
+long alloc_count(void);
+
+void* counted_malloc(size_t size);
+void* counted_calloc(size_t nmemb, size_t size);
+void* counted_realloc(void* ptr, size_t size);
+
+#define malloc(size) counted_malloc(size)
+#define calloc(nmemb, size) counted_calloc(nmemb, size)
+#define realloc(ptr, size) counted_realloc(ptr, size)
+#endif // ALLOC_COUNT
+
+
+
 
 
 #endif // __UTILS_H__
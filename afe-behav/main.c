@@ -4,6 +4,7 @@
 #include <stddef.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 #include <math.h>
 
 #include "./include/setup.h"
@@ -15,112 +16,90 @@
 #include "./include/adc.h"
 #include "./include/dfilt.h"
 #include "./include/decim.h"
+#include "./include/afe_ctx.h"
+#include "./include/run.h"
 
 const char* subject_list[] = {"P1", "P2", "P3", "P4", "P5", "P6", "S1", "S2"};
 
+// Usage: mainBehav [options] [nthreads [subjects...]]
+//     -c FILE      loads a configuration file (see afe_config_load)
+//     -s FILE      runs the points of a sweep file (see run_sweep)
+//     -p           prints the resolved configuration and exits
+//     name=value   overrides one field of the configuration (see afe_config_set)
+// Configuration files and overrides apply in the order of the command line
 int main(int argc, char* argv[]) {
-        
-    // Memory allocation
 
-    float* in1d = (float*)malloc(N_SAMPLES * sizeof(float));
-    float* in2d = (float*)malloc(N_SAMPLES * sizeof(float));
-    float* in1c = (float*)malloc(N_SAMPLES * sizeof(float));
-    float* in2c = (float*)malloc(N_SAMPLES * sizeof(float));
-
-    float* pcbOut1d = (float*)malloc(N_SAMPLES * sizeof(float));
-    float* pcbOut2d = (float*)malloc(N_SAMPLES * sizeof(float));
-    float* pcbOut1c = (float*)malloc(N_SAMPLES * sizeof(float));
-    float* pcbOut2c = (float*)malloc(N_SAMPLES * sizeof(float));
-
-    float* iaOut = (float*)malloc(N_SAMPLES * sizeof(float));
-
-    float* afiltOutp = (float*)malloc(N_SAMPLES * sizeof(float));
-    float* afiltOutn = (float*)malloc(N_SAMPLES * sizeof(float));
-
-    int** adcOut = (int**)malloc(ADC_NBITS * sizeof(int*));
-    for (int n=0; n<ADC_NBITS; n++) {
-        adcOut[n] = (int*)malloc(ADC_NSAMPLES * sizeof(int));
+    afe_config_t config;
+    afe_config_default(&config);
+
+    const char* sweep_filename = NULL;
+    int print_config = 0;
+    int nthreads = N_THREADS;
+    int nthreads_set = 0;
+    int subjects[NSUBJECTS];
+    int nsubjects = 0;
+    for (int a=1; a<argc; a++) {
+        if (strcmp(argv[a], "-c") == 0 || strcmp(argv[a], "-s") == 0) {
+            if (a + 1 >= argc) {
+                fprintf(stderr, "Missing file name after %s\n", argv[a]);
+                return 1;
+            }
+            if (argv[a][1] == 's') {
+                sweep_filename = argv[++a];
+            } else if (afe_config_load(&config, argv[++a]) != 0) {
+                return 1;
+            }
+        } else if (strcmp(argv[a], "-p") == 0) {
+            print_config = 1;
+        } else if (strchr(argv[a], '=') != NULL) {
+            if (afe_config_set(&config, argv[a]) != 0) {
+                return 1;
+            }
+        } else if (!nthreads_set) {
+            // Number of worker threads
+            nthreads = atoi(argv[a]);
+            nthreads_set = 1;
+            if (nthreads < 1) {
+                fprintf(stderr, "Invalid number of threads %s\n", argv[a]);
+                return 1;
+            }
+        } else {
+            // Subjects to run, all by default
+            int found = 0;
+            for (int i=0; i<NSUBJECTS; i++) {
+                if (strcmp(argv[a], subject_list[i]) == 0) {
+                    found = 1;
+                    if (nsubjects < NSUBJECTS) {
+                        subjects[nsubjects++] = i;
+                    }
+                    break;
+                }
+            }
+            if (!found) {
+                fprintf(stderr, "Unknown subject %s\n", argv[a]);
+                return 1;
+            }
+        }
     }
-
-    int* dfiltOut = (int*)malloc(ADC_NSAMPLES * sizeof(int));
-
-    int* out = (int*)malloc(OUT_NSAMPLES * sizeof(int));
-
-    char* output_filename = (char*)malloc(100 * sizeof(char));
-
-    char* subject;
-
-    for (int n=0; n<NSUBJECTS; n++) {
-
-        subject = (char*) subject_list[n];
-
-        printf("Running for subject %s\n", subject);
-
-        // Runs
-        for (int i=0; i<N_BUFFERS; i++) {
-            #ifdef DO_PRINT
-                printf("Buffer %d\n", i+1);
-            #endif
-            stimuliModule(in1d, in2d, in1c, in2c, i, subject);
-            #ifdef DO_PRINT
-                printf("Generated stimuli\n");
-            #endif
-            pcbModule(in1d, in2d, in1c, in2c, pcbOut1d, pcbOut2d, pcbOut1c, pcbOut2c);
-            #ifdef DO_PRINT
-                printf("Applied PCB filtering\n");
-            #endif
-            iaModule(pcbOut1d, pcbOut2d, pcbOut1c, pcbOut2c, iaOut);
-            #ifdef DO_PRINT
-                printf("Applied IA module\n");
-            #endif
-            afiltModule(iaOut, afiltOutp, afiltOutn);
-            #ifdef DO_PRINT
-                printf("Applied analog filters module\n");
-            #endif
-            adcModule(afiltOutp, afiltOutn, adcOut);
-            #ifdef DO_PRINT
-                printf("Applied ADC module\n");
-            #endif
-            dfiltModule(adcOut, dfiltOut);
-            #ifdef DO_PRINT
-                printf("Applied digital filters module\n");
-            #endif
-            decimModule(dfiltOut, out);
-            #ifdef DO_PRINT
-                printf("Applied decimation module\n");
-            #endif
-
-            sprintf(output_filename, "%s%s/behav_out/%s/buffer%d.txt", RUN_FOLDER, RUN_CATEGORY, subject, i+1);
-            write_intarray_to_file(out, OUT_NSAMPLES, output_filename);
-            #ifdef DO_PRINT
-                printf("Wrote output to file %s\n", output_filename);
-            #endif
+    if (nsubjects == 0) {
+        for (int i=0; i<NSUBJECTS; i++) {
+            subjects[nsubjects++] = i;
         }
     }
-    printf("Done\n");
 
-    // Free memory
-    free(in1d);
-    free(in2d);
-    free(in1c);
-    free(in2c);
-    free(pcbOut1d);
-    free(pcbOut2d);
-    free(pcbOut1c);
-    free(pcbOut2c);
-    free(iaOut);
-    free(afiltOutp);
-    free(afiltOutn);
-    for (int n=0; n<ADC_NBITS; n++) {
-        free(adcOut[n]);
+    if (print_config) {
+        afe_config_write(&config, stdout);
+        return 0;
     }
-    free(adcOut);
-    free(dfiltOut);
-    free(out);
-    free(output_filename);
+
+    int run_res = (sweep_filename != NULL) ? run_sweep(nthreads, subjects, nsubjects, &config, sweep_filename)
+                                           : run_buffers(nthreads, subjects, nsubjects, &config);
+    if (run_res != 0) {
+        fprintf(stderr, "Error at running subjects\n");
+        return 1;
+    }
+    printf("Done\n");
 
     return 0;
 
 }
-
-
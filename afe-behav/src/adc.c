@@ -8,34 +8,53 @@
 #include "../include/setup.h"
 #include "../include/adc.h"
 
-int adcModule(float* inp, float* inn, int** out) {
-
-    float inpval, innval;
-    int rounded_val;
-    for (int i=0; i<ADC_NSAMPLES; i++) {
-
-        inpval = inp[i * ADC_FREQUENCY_RATIO];
-        innval = inn[i * ADC_FREQUENCY_RATIO];
-        
-        // Clip inputs
-        if (inpval > ADC_VMAX) {
-            inpval = ADC_VMAX;
-        } else if (inpval < ADC_VMIN) {
-            inpval = ADC_VMIN;
+// Code of a differential sample clipped within full scale, branchless so that the loops calling it are vectorized
+// (non-negative before rounding: rounded half up, as roundf), intmax the largest code
+static inline int adc_code(float inpval, float innval, float intmax) {
+
+    // Clip inputs
+    inpval = fminf(fmaxf(inpval, (float)ADC_VMIN), (float)ADC_VMAX);
+    innval = fminf(fmaxf(innval, (float)ADC_VMIN), (float)ADC_VMAX);
+
+    // Quantization
+    float val = ((inpval - innval) / (ADC_FULLSCALE/2) + 1)/2 * intmax;
+    int truncated_val = (int)val;
+    return truncated_val + (val - truncated_val >= 0.5f);
+}
+
+int adcModule(float* inp, float* inn, adc_out_t out, afe_ctx_t* ctx) {
+
+    return adcModuleChunk(inp, inn, out, ctx->analog_nsamples, ctx->adc_stride, ctx);
+}
+
+int adcModuleChunk(float* inp, float* inn, adc_out_t out, int size, int stride, afe_ctx_t* ctx) {
+
+    int n_out = size / stride;
+    int nbits = ctx->config.adc_nbits;
+    float intmax = (float)((1 << nbits) - 1);
+
+    #ifdef ADC_BITPLANES
+        // Codes computed in the MSB vector, then split into bits (MSB last as it is overwritten)
+        int* codes = out[0];
+        for (int i=0; i<n_out; i++) {
+            codes[i] = adc_code(inp[i * stride], inn[i * stride], intmax);
         }
-        if (innval > ADC_VMAX) {
-            innval = ADC_VMAX;
-        } else if (innval < ADC_VMIN) {
-            innval = ADC_VMIN;
+        for (int n=0; n<nbits; n++) {
+            int* bits = out[nbits-1-n];
+            if (bits != codes) {
+                for (int i=0; i<n_out; i++) {
+                    bits[i] = (codes[i] >> n) & 1;
+                }
+            }
         }
-
-        // Quantization
-        rounded_val = (int)roundf(((inpval - innval) / (ADC_FULLSCALE/2) + 1)/2 * ADC_INTMAX);
-        for (int n=0; n<ADC_NBITS; n++) {
-            out[ADC_NBITS-1-n][i] = (rounded_val >> n) & 1;
+        for (int i=0; i<n_out; i++) {
+            codes[i] = (codes[i] >> (nbits-1)) & 1;
         }
-
-    }
+    #else
+        for (int i=0; i<n_out; i++) {
+            out[i] = (uint16_t)adc_code(inp[i * stride], inn[i * stride], intmax);
+        }
+    #endif // ADC_BITPLANES
 
     return 0;
 }
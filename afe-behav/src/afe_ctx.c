@@ -0,0 +1,643 @@
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <inttypes.h>
+#include <math.h>
+#include <pthread.h>
+
+#include "../include/setup.h"
+#include "../include/utils.h"
+#include "../include/afe_ctx.h"
+#include "../include/noise_bank.h"
+#include "../include/lti.h"
+#include "../include/stimuli.h"
+
+int afe_config_default(afe_config_t* config) {
+
+    config->data_folder = VENG_DATA_FOLDER;
+    config->run_folder = RUN_FOLDER;
+    config->run_category = RUN_CATEGORY;
+
+    // In stream mode, the module chain only holds one chunk at a time
+    #ifdef STREAM
+        config->chunk_nsamples = STREAM_NSAMPLES;
+    #else
+        config->chunk_nsamples = N_SAMPLES;
+    #endif // STREAM
+    config->analog_fs_ratio = ANALOG_FS_RATIO;
+    config->osr_log = ADC_OSR_LOG;
+
+    config->seed = SEED;
+    config->noise_bank_nbuffers = NOISE_BANK_NBUFFERS;
+    config->input_cm = INPUT_CM;
+    config->ia_gain = IA_GAIN;
+    config->ia_cmrr = IA_CMRR;
+    config->ia_noise = IA_NOISE;
+    config->ia_fcorner = IA_FCORNER;
+    config->afilt_gain = AFILT_GAIN;
+    config->afilt_dc_out = AFILT_DC_OUT;
+    config->afilt_dr_max = AFILT_DR_MAX;
+    config->afilt_sat_curve = AFILT_SAT_CURVE;
+    config->adc_nbits = ADC_NBITS;
+    config->interp_filter = INPUT_INTERP;
+    config->interp_ntaps = INTERP_NTAPS;
+
+    config->pcb_fl = PCB_FL;
+    config->ia_fh = IA_FH;
+    config->afilt_fl1 = AFILT_FL1;
+    config->afilt_fl2 = AFILT_FL2;
+    config->afilt_fh = AFILT_FH;
+    config->dfilt_fl = DFILT_FL;
+    config->dfilt_fh = DFILT_FH;
+
+    return 0;
+}
+
+// Fields of the configuration that can be set by name, with their type
+#define FIELD_STRING 0
+#define FIELD_INT 1
+#define FIELD_UINT64 2
+#define FIELD_FLOAT 3
+#define FIELD_DOUBLE 4
+
+typedef struct {
+    const char*     name;
+    int             type;
+    size_t          offset;
+} config_field_t;
+
+#define CONFIG_FIELD(name, type) {#name, type, offsetof(afe_config_t, name)}
+
+static const config_field_t config_fields[] = {
+    CONFIG_FIELD(data_folder, FIELD_STRING),
+    CONFIG_FIELD(run_folder, FIELD_STRING),
+    CONFIG_FIELD(run_category, FIELD_STRING),
+    CONFIG_FIELD(chunk_nsamples, FIELD_INT),
+    CONFIG_FIELD(analog_fs_ratio, FIELD_INT),
+    CONFIG_FIELD(osr_log, FIELD_INT),
+    CONFIG_FIELD(seed, FIELD_UINT64),
+    CONFIG_FIELD(noise_bank_nbuffers, FIELD_INT),
+    CONFIG_FIELD(input_cm, FIELD_DOUBLE),
+    CONFIG_FIELD(ia_gain, FIELD_FLOAT),
+    CONFIG_FIELD(ia_cmrr, FIELD_FLOAT),
+    CONFIG_FIELD(ia_noise, FIELD_FLOAT),
+    CONFIG_FIELD(ia_fcorner, FIELD_FLOAT),
+    CONFIG_FIELD(afilt_gain, FIELD_FLOAT),
+    CONFIG_FIELD(afilt_dc_out, FIELD_FLOAT),
+    CONFIG_FIELD(afilt_dr_max, FIELD_FLOAT),
+    CONFIG_FIELD(afilt_sat_curve, FIELD_INT),
+    CONFIG_FIELD(adc_nbits, FIELD_INT),
+    CONFIG_FIELD(interp_filter, FIELD_INT),
+    CONFIG_FIELD(interp_ntaps, FIELD_INT),
+    CONFIG_FIELD(pcb_fl, FIELD_DOUBLE),
+    CONFIG_FIELD(ia_fh, FIELD_DOUBLE),
+    CONFIG_FIELD(afilt_fl1, FIELD_DOUBLE),
+    CONFIG_FIELD(afilt_fl2, FIELD_DOUBLE),
+    CONFIG_FIELD(afilt_fh, FIELD_DOUBLE),
+    CONFIG_FIELD(dfilt_fl, FIELD_DOUBLE),
+    CONFIG_FIELD(dfilt_fh, FIELD_DOUBLE),
+};
+
+#define N_CONFIG_FIELDS ((int)(sizeof(config_fields) / sizeof(config_fields[0])))
+
+// Copy of the characters from start to end, without the surrounding white spaces
+static char* trimmed_copy(const char* start, const char* end) {
+
+    while (start < end && (*start == ' ' || *start == '\t')) {
+        start++;
+    }
+    while (end > start && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r' || end[-1] == '\n')) {
+        end--;
+    }
+    char* copy = (char*)malloc(end - start + 1);
+    if (copy != NULL) {
+        memcpy(copy, start, end - start);
+        copy[end - start] = '\0';
+    }
+    return copy;
+}
+
+int afe_config_set(afe_config_t* config, const char* assignment) {
+
+    const char* equal = strchr(assignment, '=');
+    if (equal == NULL) {
+        fprintf(stderr, "Invalid configuration assignment %s, expected name=value\n", assignment);
+        return 1;
+    }
+    char* name = trimmed_copy(assignment, equal);
+    char* value = trimmed_copy(equal + 1, equal + strlen(equal));
+    if (name == NULL || value == NULL) {
+        free(name);
+        free(value);
+        return 1;
+    }
+
+    const config_field_t* field = NULL;
+    for (int k=0; k<N_CONFIG_FIELDS; k++) {
+        if (strcmp(config_fields[k].name, name) == 0) {
+            field = &config_fields[k];
+        }
+    }
+    int res = 0;
+    char* end = value;
+    void* dst = (char*)config + (field != NULL ? field->offset : 0);
+    if (field == NULL) {
+        fprintf(stderr, "Unknown configuration field %s\n", name);
+        res = 1;
+    } else if (field->type == FIELD_STRING) {
+        // Kept until the end of the process, as the string literals of the defaults
+        *(const char**)dst = value;
+        value = NULL;
+    } else if (field->type == FIELD_INT) {
+        *(int*)dst = (int)strtol(value, &end, 10);
+    } else if (field->type == FIELD_UINT64) {
+        *(uint64_t*)dst = (uint64_t)strtoull(value, &end, 10);
+    } else if (field->type == FIELD_FLOAT) {
+        *(float*)dst = strtof(value, &end);
+    } else {
+        *(double*)dst = strtod(value, &end);
+    }
+    if (value != NULL && field != NULL && (end == value || *end != '\0')) {
+        fprintf(stderr, "Invalid value %s for configuration field %s\n", value, name);
+        res = 1;
+    }
+
+    free(name);
+    free(value);
+    return res;
+}
+
+int afe_config_load(afe_config_t* config, const char* filename) {
+
+    FILE* file = fopen(filename, "r");
+    if (file == NULL) {
+        fprintf(stderr, "Load configuration: Error opening file %s\n", filename);
+        return 1;
+    }
+
+    int res = 0;
+    char line[CONFIG_LINE_MAX];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        // Comments start with #, blank lines are skipped
+        char* comment = strchr(line, '#');
+        if (comment != NULL) {
+            *comment = '\0';
+        }
+        if (strspn(line, " \t\r\n") == strlen(line)) {
+            continue;
+        }
+        if (afe_config_set(config, line) != 0) {
+            res = 1;
+        }
+    }
+
+    fclose(file);
+    return res;
+}
+
+int afe_config_write(const afe_config_t* config, FILE* file) {
+
+    for (int k=0; k<N_CONFIG_FIELDS; k++) {
+        const config_field_t* field = &config_fields[k];
+        const void* src = (const char*)config + field->offset;
+        fprintf(file, "%s = ", field->name);
+        if (field->type == FIELD_STRING) {
+            fprintf(file, "%s\n", *(const char* const*)src);
+        } else if (field->type == FIELD_INT) {
+            fprintf(file, "%d\n", *(const int*)src);
+        } else if (field->type == FIELD_UINT64) {
+            fprintf(file, "%" PRIu64 "\n", *(const uint64_t*)src);
+        } else if (field->type == FIELD_FLOAT) {
+            fprintf(file, "%.9g\n", *(const float*)src);
+        } else {
+            fprintf(file, "%.17g\n", *(const double*)src);
+        }
+    }
+
+    return 0;
+}
+
+// Analog frequency (rad/s) mapped to w by the bilinear transform at fs
+// Not prewarped at FS, as the look-up tables, so that run-time designs at FS are continuous with them
+static double prewarp(double w, double fs) {
+
+    return (fs == FS) ? w : 2 * fs * tan(w / (2 * fs));
+}
+
+// Coefficients of the analog filters at fs: look-up tables at FS for the default cutoffs (reference, compile-time constants),
+// else bilinear transform of the analog prototypes, with prewarped poles below FS so that the corner frequencies stay in
+// place at low rates (e.g. the 43-kHz IA pole at 160 kS/s)
+// The delta-operator forms of the AFILT biquads (IIR_DELTA) are always designed from the prototypes
+static void analog_coefs_init(analog_coefs_t* coefs, int fs, const afe_config_t* config) {
+
+    int lookup = (fs == FS);
+
+    // PCB: 1st-order HPF
+    if (lookup && config->pcb_fl == PCB_FL) {
+        *coefs = (analog_coefs_t){.pcb_alpha = {PCB_ALPHA_0, PCB_ALPHA_1}, .pcb_beta = {PCB_BETA_0, PCB_BETA_1}};
+    } else {
+        double pcb_w = prewarp(TWO_PI * config->pcb_fl, fs);
+        bilinear_order_1((double[]){1, 0}, (double[]){1, pcb_w}, fs, coefs->pcb_alpha, coefs->pcb_beta);
+    }
+
+    // IA: 1st-order LPF
+    if (lookup && config->ia_fh == IA_FH) {
+        memcpy(coefs->ia_alpha, (float[]){IA_ALPHA_0, IA_ALPHA_1}, sizeof(coefs->ia_alpha));
+        memcpy(coefs->ia_beta, (float[]){IA_BETA_0, IA_BETA_1}, sizeof(coefs->ia_beta));
+    } else {
+        double ia_w = prewarp(TWO_PI * config->ia_fh, fs);
+        bilinear_order_1((double[]){0, ia_w}, (double[]){1, ia_w}, fs, coefs->ia_alpha, coefs->ia_beta);
+    }
+
+    // AFILT HPF: two real poles at afilt_fl1 and afilt_fl2
+    double hpf_w1 = prewarp(TWO_PI * config->afilt_fl1, fs);
+    double hpf_w2 = prewarp(TWO_PI * config->afilt_fl2, fs);
+    double hpf_b[3] = {1, 0, 0};
+    double hpf_a[3] = {1, hpf_w1 + hpf_w2, hpf_w1 * hpf_w2};
+    if (lookup && config->afilt_fl1 == AFILT_FL1 && config->afilt_fl2 == AFILT_FL2) {
+        memcpy(coefs->afilt_hpf_alpha, (float[]){AFILT_HPF_ALPHA_0, AFILT_HPF_ALPHA_1, AFILT_HPF_ALPHA_2}, sizeof(coefs->afilt_hpf_alpha));
+        memcpy(coefs->afilt_hpf_beta, (float[]){AFILT_HPF_BETA_0, AFILT_HPF_BETA_1, AFILT_HPF_BETA_2}, sizeof(coefs->afilt_hpf_beta));
+    } else {
+        bilinear_order_2(hpf_b, hpf_a, fs, coefs->afilt_hpf_alpha, coefs->afilt_hpf_beta);
+    }
+    bilinear_order_2_delta(hpf_b, hpf_a, fs, coefs->afilt_hpf_delta);
+
+    // AFILT LPF: double real pole, -3 dB at afilt_fh
+    double lpf_w = prewarp(TWO_PI * config->afilt_fh / sqrt(sqrt(2) - 1), fs);
+    double lpf_b[3] = {0, 0, lpf_w * lpf_w};
+    double lpf_a[3] = {1, 2 * lpf_w, lpf_w * lpf_w};
+    if (lookup && config->afilt_fh == AFILT_FH) {
+        memcpy(coefs->afilt_lpf_alpha, (float[]){AFILT_LPF_ALPHA_0, AFILT_LPF_ALPHA_1, AFILT_LPF_ALPHA_2}, sizeof(coefs->afilt_lpf_alpha));
+        memcpy(coefs->afilt_lpf_beta, (float[]){AFILT_LPF_BETA_0, AFILT_LPF_BETA_1, AFILT_LPF_BETA_2}, sizeof(coefs->afilt_lpf_beta));
+    } else {
+        bilinear_order_2(lpf_b, lpf_a, fs, coefs->afilt_lpf_alpha, coefs->afilt_lpf_beta);
+    }
+    bilinear_order_2_delta(lpf_b, lpf_a, fs, coefs->afilt_lpf_delta);
+}
+
+// Coefficients of the digital filters at the ADC rate fs: look-up tables for the default cutoffs at the default ADC rate,
+// else bilinear transform of the analog prototypes without prewarping, as the tables (double real poles, -3 dB at the cutoffs)
+static void dfilt_coefs_init(dfilt_coefs_t* coefs, int fs, const afe_config_t* config) {
+
+    int lookup = (fs == FS / ADC_FREQUENCY_RATIO);
+
+    // HPF
+    if (lookup && config->dfilt_fl == DFILT_FL) {
+        memcpy(coefs->hpf_alpha, (double[]){DFILT_HPF_ALPHA_0, DFILT_HPF_ALPHA_1, DFILT_HPF_ALPHA_2}, sizeof(coefs->hpf_alpha));
+        memcpy(coefs->hpf_beta, (double[]){DFILT_HPF_BETA_0, DFILT_HPF_BETA_1, DFILT_HPF_BETA_2}, sizeof(coefs->hpf_beta));
+    } else {
+        double hpf_w = TWO_PI * config->dfilt_fl * sqrt(sqrt(2) - 1);
+        bilinear_order_2_double((double[]){1, 0, 0}, (double[]){1, 2 * hpf_w, hpf_w * hpf_w}, fs, coefs->hpf_alpha, coefs->hpf_beta);
+    }
+
+    // LPF
+    if (lookup && config->dfilt_fh == DFILT_FH) {
+        memcpy(coefs->lpf_alpha, (double[]){DFILT_LPF_ALPHA_0, DFILT_LPF_ALPHA_1, DFILT_LPF_ALPHA_2}, sizeof(coefs->lpf_alpha));
+        memcpy(coefs->lpf_beta, (double[]){DFILT_LPF_BETA_0, DFILT_LPF_BETA_1, DFILT_LPF_BETA_2}, sizeof(coefs->lpf_beta));
+    } else {
+        double lpf_w = TWO_PI * config->dfilt_fh / sqrt(sqrt(2) - 1);
+        bilinear_order_2_double((double[]){0, 0, lpf_w * lpf_w}, (double[]){1, 2 * lpf_w, lpf_w * lpf_w}, fs, coefs->lpf_alpha, coefs->lpf_beta);
+    }
+}
+
+// Filter designs memoized by analog and ADC rates and cutoffs, shared by all contexts (the worker threads and the points of a sweep
+// design the same filters again), replaced in turn when the cache is full
+typedef struct {
+    int             analog_fs;
+    int             adc_fs;
+    double          cutoffs[7];
+    analog_coefs_t  analog_coefs;
+    dfilt_coefs_t   dfilt_coefs;
+} filter_design_t;
+
+static filter_design_t filter_cache[FILTER_CACHE_SIZE];
+static int filter_cache_nentries = 0;
+static int filter_cache_next = 0;
+static pthread_mutex_t filter_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void filters_init(afe_ctx_t* ctx) {
+
+    const afe_config_t* config = &ctx->config;
+    filter_design_t design = {
+        .analog_fs = ctx->analog_fs,
+        .adc_fs = FS / ctx->adc_fs_ratio,
+        .cutoffs = {config->pcb_fl, config->ia_fh, config->afilt_fl1, config->afilt_fl2, config->afilt_fh, config->dfilt_fl, config->dfilt_fh},
+    };
+
+    pthread_mutex_lock(&filter_cache_lock);
+    int found = 0;
+    for (int k=0; k<filter_cache_nentries && !found; k++) {
+        if (filter_cache[k].analog_fs == design.analog_fs && filter_cache[k].adc_fs == design.adc_fs && memcmp(filter_cache[k].cutoffs, design.cutoffs, sizeof(design.cutoffs)) == 0) {
+            design = filter_cache[k];
+            found = 1;
+        }
+    }
+    if (!found) {
+        analog_coefs_init(&design.analog_coefs, design.analog_fs, config);
+        dfilt_coefs_init(&design.dfilt_coefs, design.adc_fs, config);
+        filter_cache[filter_cache_next] = design;
+        filter_cache_next = (filter_cache_next + 1) % FILTER_CACHE_SIZE;
+        if (filter_cache_nentries < FILTER_CACHE_SIZE) {
+            filter_cache_nentries++;
+        }
+    }
+    pthread_mutex_unlock(&filter_cache_lock);
+
+    ctx->analog_coefs = design.analog_coefs;
+    ctx->dfilt_coefs = design.dfilt_coefs;
+}
+
+// Least common multiple of two positive integers
+static int lcm(int a, int b) {
+
+    int x = a;
+    int y = b;
+    while (y != 0) {
+        int r = x % y;
+        x = y;
+        y = r;
+    }
+    return a / x * b;
+}
+
+int afe_ctx_init(afe_ctx_t* ctx, const afe_config_t* config) {
+
+    *ctx = (afe_ctx_t){0};
+
+    if (config != NULL) {
+        ctx->config = *config;
+    } else {
+        afe_config_default(&ctx->config);
+    }
+
+    // ADC rate: output rate (FS/OUT_FS_RATIO, fixed) times the oversampling, up to FS
+    int osr_log = ctx->config.osr_log;
+    int osr_log_max = 0;
+    while (osr_log_max < DECIM_OSR_LOG_MAX && OUT_FS_RATIO % (2 << osr_log_max) == 0) {
+        osr_log_max++;
+    }
+    if (osr_log < 0 || osr_log > osr_log_max) {
+        fprintf(stderr, "Invalid oversampling 2^%d, must be from 2^0 to 2^%d\n", osr_log, osr_log_max);
+        return 1;
+    }
+    ctx->adc_fs_ratio = OUT_FS_RATIO >> osr_log;
+    ctx->adc_nsamples = N_SAMPLES / ctx->adc_fs_ratio;
+
+    // Rates of the chain: experimental data oversampled to the analog modules, themselves sampled by the ADC
+    int analog_fs_ratio = ctx->config.analog_fs_ratio;
+    if (analog_fs_ratio <= 0 || INPUT_FS_RATIO % analog_fs_ratio != 0 || ctx->adc_fs_ratio % analog_fs_ratio != 0) {
+        fprintf(stderr, "Invalid analog rate ratio %d, must divide %d and %d\n", analog_fs_ratio, INPUT_FS_RATIO, ctx->adc_fs_ratio);
+        return 1;
+    }
+    ctx->analog_fs = FS / analog_fs_ratio;
+    ctx->analog_nsamples = N_SAMPLES / analog_fs_ratio;
+    ctx->input_ratio = INPUT_FS_RATIO / analog_fs_ratio;
+    ctx->adc_stride = ctx->adc_fs_ratio / analog_fs_ratio;
+
+    // Chunks hold whole output samples, whole experimental data samples and whole analog samples
+    int chunk_nsamples = ctx->config.chunk_nsamples;
+    int chunk_multiple = lcm(lcm(OUT_FS_RATIO, INPUT_FS_RATIO), analog_fs_ratio);
+    if (chunk_nsamples <= 0 || chunk_nsamples > N_SAMPLES || chunk_nsamples % chunk_multiple != 0) {
+        fprintf(stderr, "Invalid chunk size %d, must be a multiple of %d up to %d\n", chunk_nsamples, chunk_multiple, N_SAMPLES);
+        return 1;
+    }
+    #ifndef CHUNKED
+        // Full buffers go through the module chain at once, the vectors of the modules hold a whole buffer
+        if (chunk_nsamples != N_SAMPLES) {
+            fprintf(stderr, "Invalid chunk size %d, must be %d without STREAM or CONTINUOUS\n", chunk_nsamples, N_SAMPLES);
+            return 1;
+        }
+    #endif // CHUNKED
+    if (interp_design(&ctx->interp, ctx->input_ratio, ctx->config.interp_filter, ctx->config.interp_ntaps) != 0) {
+        return 1;
+    }
+    if (ctx->config.ia_fh >= ctx->analog_fs / 2) {
+        fprintf(stderr, "Analog rate %d S/s too low for the IA bandwidth (%g Hz)\n", ctx->analog_fs, ctx->config.ia_fh);
+        return 1;
+    }
+
+    // Filter cutoffs, below the Nyquist frequency of their rate
+    const afe_config_t* c = &ctx->config;
+    double analog_cutoffs[5] = {c->pcb_fl, c->ia_fh, c->afilt_fl1, c->afilt_fl2, c->afilt_fh};
+    double dfilt_cutoffs[2] = {c->dfilt_fl, c->dfilt_fh};
+    for (int k=0; k<5; k++) {
+        if (!(analog_cutoffs[k] > 0 && analog_cutoffs[k] < ctx->analog_fs / 2)) {
+            fprintf(stderr, "Invalid analog filter cutoff %g Hz, must be between 0 and %d Hz\n", analog_cutoffs[k], ctx->analog_fs / 2);
+            return 1;
+        }
+    }
+    for (int k=0; k<2; k++) {
+        if (!(dfilt_cutoffs[k] > 0 && dfilt_cutoffs[k] < FS / ctx->adc_fs_ratio / 2)) {
+            fprintf(stderr, "Invalid digital filter cutoff %g Hz, must be between 0 and %d Hz\n", dfilt_cutoffs[k], FS / ctx->adc_fs_ratio / 2);
+            return 1;
+        }
+    }
+    filters_init(ctx);
+
+    int adc_nbits = ctx->config.adc_nbits;
+    if (adc_nbits < 1 || adc_nbits > ADC_NBITS_MAX || adc_nbits > OUT_NBITS) {
+        fprintf(stderr, "Invalid ADC resolution %d bits, must be from 1 to %d\n", adc_nbits, ADC_NBITS_MAX);
+        return 1;
+    }
+
+    int sat_curve = ctx->config.afilt_sat_curve;
+    if (sat_curve != SAT_CURVE_SINE && sat_curve != SAT_CURVE_TANH && sat_curve != SAT_CURVE_PIECEWISE) {
+        fprintf(stderr, "Invalid saturation curve %d\n", sat_curve);
+        return 1;
+    }
+
+    // Linear path as one FIR filter, built from the analog coefficients and the gains
+    #ifdef LTI_FFT
+        if (ltiInit(ctx) != 0) {
+            return 1;
+        }
+    #endif // LTI_FFT
+
+    ctx->in1d = (float*)malloc(chunk_nsamples * sizeof(float));
+    ctx->in2d = (float*)malloc(chunk_nsamples * sizeof(float));
+    ctx->in1c = (float*)malloc(chunk_nsamples * sizeof(float));
+    ctx->in2c = (float*)malloc(chunk_nsamples * sizeof(float));
+
+    ctx->pcbOut1d = (float*)malloc(chunk_nsamples * sizeof(float));
+    ctx->pcbOut2d = (float*)malloc(chunk_nsamples * sizeof(float));
+    ctx->pcbOut1c = (float*)malloc(chunk_nsamples * sizeof(float));
+    ctx->pcbOut2c = (float*)malloc(chunk_nsamples * sizeof(float));
+
+    ctx->iaOut = (float*)malloc(chunk_nsamples * sizeof(float));
+
+    ctx->afiltOutp = (float*)malloc(chunk_nsamples * sizeof(float));
+    ctx->afiltOutn = (float*)malloc(chunk_nsamples * sizeof(float));
+
+    #ifdef ADC_BITPLANES
+        ctx->adcOut = (int**)calloc(adc_nbits, sizeof(int*));
+        if (ctx->adcOut == NULL) {
+            return 1;
+        }
+        for (int n=0; n<adc_nbits; n++) {
+            ctx->adcOut[n] = (int*)malloc(chunk_nsamples / ctx->adc_fs_ratio * sizeof(int));
+            if (ctx->adcOut[n] == NULL) {
+                return 1;
+            }
+        }
+    #else
+        ctx->adcOut = (uint16_t*)malloc(chunk_nsamples / ctx->adc_fs_ratio * sizeof(uint16_t));
+        if (ctx->adcOut == NULL) {
+            return 1;
+        }
+    #endif // ADC_BITPLANES
+
+    // Full-rate digital filter outputs, only kept by the reference path (the fused stage works on stack tiles)
+    #ifdef DECIM_UNFUSED
+        ctx->dfiltOut = (int*)malloc(chunk_nsamples / ctx->adc_fs_ratio * sizeof(int));
+        if (ctx->dfiltOut == NULL) {
+            return 1;
+        }
+    #endif // DECIM_UNFUSED
+
+    ctx->out = (int*)malloc(OUT_NSAMPLES * sizeof(int));
+
+    // Noise bank or noise synthesis of the CM inputs (one stream of half the power with COLLAPSE_LINEAR) and of the IA, at the analog rate
+    #ifdef NOISE_BANK
+        float cm_band[2] = {INPUT_CM_FMIN, INPUT_CM_FMAX};
+        float ia_band[2] = {FL, FH};
+        float cm_power = ctx->config.input_cm * ctx->config.input_cm;
+        #ifdef COLLAPSE_LINEAR
+            cm_power /= 2;
+        #endif // COLLAPSE_LINEAR
+        if (noise_bank_open(&ctx->noise_bank, &ctx->config) != 0) {
+            return 1;
+        }
+        noise_bank_set_power(&ctx->noise_bank, RNG_STREAM_CM1, ctx->analog_fs, cm_power, INPUT_CM_FMAX, cm_band);
+        noise_bank_set_power(&ctx->noise_bank, RNG_STREAM_CM2, ctx->analog_fs, cm_power, INPUT_CM_FMAX, cm_band);
+        noise_bank_set_power(&ctx->noise_bank, RNG_STREAM_IA, ctx->analog_fs, ctx->config.ia_noise * ctx->config.ia_noise, ctx->config.ia_fcorner, ia_band);
+    #elif defined(NOISE_SYNTH)
+        float cm_band[2] = {INPUT_CM_FMIN, INPUT_CM_FMAX};
+        float ia_band[2] = {FL, FH};
+        float cm_power = ctx->config.input_cm * ctx->config.input_cm;
+        #ifdef COLLAPSE_LINEAR
+            cm_power /= 2;
+        #endif // COLLAPSE_LINEAR
+        if (noise_synth_init(&ctx->noise_synth[RNG_STREAM_CM1], ctx->analog_fs, cm_power, INPUT_CM_FMAX, cm_band) != 0
+            || noise_synth_init(&ctx->noise_synth[RNG_STREAM_CM2], ctx->analog_fs, cm_power, INPUT_CM_FMAX, cm_band) != 0
+            || noise_synth_init(&ctx->noise_synth[RNG_STREAM_IA], ctx->analog_fs, ctx->config.ia_noise * ctx->config.ia_noise, ctx->config.ia_fcorner, ia_band) != 0) {
+            return 1;
+        }
+    #endif // NOISE_BANK, NOISE_SYNTH
+
+    // Buffer-level stimuli, drawn once per segment to keep the same random sequence as the full-buffer chain
+    #ifdef CHUNKED
+        ctx->stimuli_buffer.in1 = (double*)malloc(STIMULI_INPUT_NSAMPLES * sizeof(double));
+        ctx->stimuli_buffer.in2 = (double*)malloc(STIMULI_INPUT_NSAMPLES * sizeof(double));
+        ctx->stimuli_buffer.in1c = (float*)malloc(N_SAMPLES * sizeof(float));
+        ctx->stimuli_buffer.in2c = (float*)malloc(N_SAMPLES * sizeof(float));
+        if (ctx->stimuli_buffer.in1 == NULL || ctx->stimuli_buffer.in2 == NULL || ctx->stimuli_buffer.in1c == NULL || ctx->stimuli_buffer.in2c == NULL) {
+            return 1;
+        }
+    #endif // CHUNKED
+
+    // IA noise of a whole segment
+    #ifdef NOISY
+        ctx->iaNoise = (float*)malloc(N_SAMPLES * sizeof(float));
+        if (ctx->iaNoise == NULL) {
+            return 1;
+        }
+    #endif // NOISY
+
+    if (ctx->in1d == NULL || ctx->in2d == NULL || ctx->in1c == NULL || ctx->in2c == NULL
+        || ctx->pcbOut1d == NULL || ctx->pcbOut2d == NULL || ctx->pcbOut1c == NULL || ctx->pcbOut2c == NULL
+        || ctx->iaOut == NULL || ctx->afiltOutp == NULL || ctx->afiltOutn == NULL || ctx->out == NULL) {
+        return 1;
+    }
+
+    // Temporaries of the modules: the full-buffer stimuli are read as double before oversampling
+    size_t scratch_size = 0;
+    #ifndef CHUNKED
+        scratch_size += INPUT_NSAMPLES * sizeof(double) + SCRATCH_ALIGN;
+    #endif // CHUNKED
+    if (scratch_init(&ctx->scratch, scratch_size) != 0) {
+        return 1;
+    }
+
+    afe_ctx_seed(ctx, 0, 0);
+
+    return 0;
+}
+
+int afe_ctx_free(afe_ctx_t* ctx) {
+
+    free(ctx->in1d);
+    free(ctx->in2d);
+    free(ctx->in1c);
+    free(ctx->in2c);
+    free(ctx->pcbOut1d);
+    free(ctx->pcbOut2d);
+    free(ctx->pcbOut1c);
+    free(ctx->pcbOut2c);
+    free(ctx->iaOut);
+    free(ctx->afiltOutp);
+    free(ctx->afiltOutn);
+    #ifdef ADC_BITPLANES
+        if (ctx->adcOut != NULL) {
+            for (int n=0; n<ctx->config.adc_nbits; n++) {
+                free(ctx->adcOut[n]);
+            }
+        }
+    #endif // ADC_BITPLANES
+    free(ctx->adcOut);
+    free(ctx->dfiltOut);
+    free(ctx->out);
+    free(ctx->stimuli_buffer.in1);
+    free(ctx->stimuli_buffer.in2);
+    free(ctx->stimuli_buffer.in1c);
+    free(ctx->stimuli_buffer.in2c);
+    free(ctx->iaNoise);
+    free(ctx->lti.a_re);
+    free(ctx->lti.a_im);
+    free(ctx->lti.b_re);
+    free(ctx->lti.b_im);
+    free(ctx->lti.tw_re);
+    free(ctx->lti.tw_im);
+    free(ctx->lti.z_re);
+    free(ctx->lti.z_im);
+    free(ctx->lti.y_re);
+    free(ctx->lti.y_im);
+    free(ctx->lti.hist);
+    free(ctx->lti.hist_noise);
+    for (int k=0; k<N_RNG_STREAMS; k++) {
+        noise_synth_free(&ctx->noise_synth[k]);
+    }
+    noise_bank_close(&ctx->noise_bank);
+    scratch_free(&ctx->scratch);
+
+    return 0;
+}
+
+int afe_ctx_reset(afe_ctx_t* ctx) {
+
+    ctx->chain_state = (chain_state_t){0};
+    ctx->stimuli_buffer.in1_interp = (interp_state_t){0};
+    ctx->stimuli_buffer.in2_interp = (interp_state_t){0};
+    for (int k=0; k<N_RNG_STREAMS; k++) {
+        noise_synth_reset(&ctx->noise_synth[k]);
+    }
+    if (ctx->lti.hist != NULL) {
+        memset(ctx->lti.hist, 0, ctx->lti.ntaps * sizeof(float));
+        memset(ctx->lti.hist_noise, 0, ctx->lti.ntaps * sizeof(float));
+    }
+
+    return 0;
+}
+
+int afe_ctx_seed(afe_ctx_t* ctx, uint32_t subject_idx, uint32_t buffer_idx) {
+
+    for (int k=0; k<N_RNG_STREAMS; k++) {
+        rng_seed(&ctx->rng[k], ctx->config.seed, subject_idx, buffer_idx, k);
+    }
+    #ifdef NOISE_BANK
+        noise_bank_seek(&ctx->noise_bank, ctx->config.seed, subject_idx, buffer_idx);
+    #endif // NOISE_BANK
+
+    return 0;
+}
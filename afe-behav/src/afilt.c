@@ -9,55 +9,66 @@
 #include "../include/utils.h"
 #include "../include/afilt.h"
 
-int afiltModule(float* in, float* outp, float* outn) {
+int afiltModule(float* in, float* outp, float* outn, int stride, afe_ctx_t* ctx) {
 
-    float* v_gain = malloc(N_SAMPLES * sizeof(float));
-    // Gain
-    for (int i=0; i<N_SAMPLES; i++) {
-        v_gain[i] = AFILT_GAIN * in[i];
-    }
+    return afiltModuleChunk(in, outp, outn, ctx->analog_nsamples, stride, ctx);
 
-    // HPF
-    float* v_hpf = malloc(N_SAMPLES * sizeof(float));
-    float hpf_alpha[3] = {AFILT_HPF_ALPHA_0, AFILT_HPF_ALPHA_1, AFILT_HPF_ALPHA_2};
-    float hpf_beta[3] = {AFILT_HPF_BETA_0, AFILT_HPF_BETA_1, AFILT_HPF_BETA_2};
-    iir_order_2(v_gain, v_hpf, N_SAMPLES, hpf_alpha, hpf_beta);
-    free(v_gain);
+}
 
-    // LPF
-    float* v_lpf = malloc(N_SAMPLES * sizeof(float));
-    float lpf_alpha[3] = {AFILT_LPF_ALPHA_0, AFILT_LPF_ALPHA_1, AFILT_LPF_ALPHA_2};
-    float lpf_beta[3] = {AFILT_LPF_BETA_0, AFILT_LPF_BETA_1, AFILT_LPF_BETA_2};
-    iir_order_2(v_hpf, v_lpf, N_SAMPLES, lpf_alpha, lpf_beta);
-    free(v_hpf);
+int afiltModuleChunk(float* in, float* outp, float* outn, int size, int stride, afe_ctx_t* ctx) {
 
-    // Saturation
-    float* v_sat = malloc(N_SAMPLES * sizeof(float));
-    #ifdef SATURATE
-        float dr_max_pi2 = HALF_PI * AFILT_DR_MAX;
-        for (int i=0; i<N_SAMPLES; i++) {
-            if (v_lpf[i] > dr_max_pi2) {
-                v_sat[i] = AFILT_DR_MAX;
-            } else if (v_lpf[i] < -dr_max_pi2) {
-                v_sat[i] = -AFILT_DR_MAX;
-            } else {
-                v_sat[i] = AFILT_DR_MAX * sinf(v_lpf[i] / AFILT_DR_MAX);
-            }
-        }
+    chain_state_t* state = &ctx->chain_state;
+    float gain = ctx->config.afilt_gain;
+    float dr_max = ctx->config.afilt_dr_max;
+    float dc_out = ctx->config.afilt_dc_out;
+    float* v = outp;
+
+    analog_coefs_t* coefs = &ctx->analog_coefs;
+    #ifdef LTI_FFT
+        // Gain and LPF already applied by ltiModuleChunk, only the HPF is left (its impulse response is too long for the FIR)
+        (void)gain;
+        #ifdef IIR_DELTA
+            iir_order_2_delta_chunk(in, v, size, coefs->afilt_hpf_delta, &state->afilt_hpf_delta);
+        #else
+            iir_order_2_chunk(in, v, size, coefs->afilt_hpf_alpha, coefs->afilt_hpf_beta, &state->afilt_hpf);
+        #endif // IIR_DELTA
     #else
-        for (int i=0; i<N_SAMPLES; i++) {
-            v_sat[i] = v_lpf[i];
+        // Gain
+        for (int i=0; i<size; i++) {
+            v[i] = gain * in[i];
         }
+
+        // HPF and LPF
+        #ifdef IIR_DELTA
+            iir_order_2_delta_chunk(v, v, size, coefs->afilt_hpf_delta, &state->afilt_hpf_delta);
+            iir_order_2_delta_chunk(v, v, size, coefs->afilt_lpf_delta, &state->afilt_lpf_delta);
+        #else
+            iir_order_2_chunk(v, v, size, coefs->afilt_hpf_alpha, coefs->afilt_hpf_beta, &state->afilt_hpf);
+            iir_order_2_chunk(v, v, size, coefs->afilt_lpf_alpha, coefs->afilt_lpf_beta, &state->afilt_lpf);
+        #endif // IIR_DELTA
+    #endif // LTI_FFT
+
+    // Memoryless stages, only at the samples read by the consumer (every stride samples)
+    // gathered contiguously in outn, so that the saturation loop stays vectorized
+    int n = size / stride;
+    float* w = outn;
+    for (int k=0; k<n; k++) {
+        w[k] = v[k * stride];
+    }
+
+    // Saturation
+    #ifdef SATURATE
+        saturate(w, n, dr_max, ctx->config.afilt_sat_curve);
     #endif // SATURATE
-    free(v_lpf);
 
-    // DC value
-    for (int i=0; i<N_SAMPLES; i++) {
-        outp[i] = AFILT_DC_OUT + v_sat[i]/2;
-        outn[i] = AFILT_DC_OUT - v_sat[i]/2;
+    // DC value, back at the consumer sample instants (backwards, as w[k] is overwritten at k*stride >= k)
+    for (int k=n-1; k>=0; k--) {
+        float wk = w[k];
+        outp[k * stride] = dc_out + wk/2;
+        outn[k * stride] = dc_out - wk/2;
     }
-    free(v_sat);
     
     return 0;
 
 }
+
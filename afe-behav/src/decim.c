@@ -1,4 +1,3 @@
-
 #include <stdio.h>
 #include <stddef.h>
 #include <stdlib.h>
@@ -6,21 +5,65 @@
 #include <math.h>
 
 #include "../include/setup.h"
+#include "../include/utils.h"
+#include "../include/dfilt.h"
 #include "../include/decim.h"
 
 
-int decimModule(int* in, int* out) {
+int decimModule(int* in, int* out, afe_ctx_t* ctx) {
+
+    return decimModuleChunk(in, out, ctx->adc_nsamples, ctx);
+
+}
+
+int decimModuleChunk(int* in, int* out, int size, afe_ctx_t* ctx) {
 
     int sum_in = 0;
-    int adc_osr = pow(2, ADC_OSR_LOG);
-    for (int i=0; i<OUT_NSAMPLES; i++) {
+    int osr_log = ctx->config.osr_log;
+    int adc_osr = 1 << osr_log;
+    for (int i=0; i<(size >> osr_log); i++) {
         sum_in = 0;
         for (int j=0; j<adc_osr; j++) {
-            sum_in += in[(i << ADC_OSR_LOG) + j];
+            sum_in += in[(i << osr_log) + j];
         }
-        out[i] = sum_in >> ADC_OSR_LOG;
+        #ifdef DFILT_FIXED
+            // Rounding and overflow of the digital filters (the sum itself is exact)
+            out[i] = (int)fixed_overflow(fixed_shift(sum_in, osr_log, DFILT_ROUNDING), OUT_NBITS, DFILT_SATURATION);
+        #else
+            out[i] = sum_in >> osr_log;
+        #endif // DFILT_FIXED
+    }
+
+    return 0;
+
+}
+
+int dfiltDecimModule(adc_out_t in, int* out, afe_ctx_t* ctx) {
+
+    return dfiltDecimModuleChunk(in, out, ctx->adc_nsamples, ctx);
+
+}
+
+int dfiltDecimModuleChunk(adc_out_t in, int* out, int size, afe_ctx_t* ctx) {
+
+    // The recursive filters need every sample: they run tile by tile in L1 cache, and only the averages leave the tile
+    int tile[DECIM_TILE_NSAMPLES];
+    int osr_log = ctx->config.osr_log;
+    int n;
+    for (int offset=0; offset<size; offset+=n) {
+        n = (size - offset < DECIM_TILE_NSAMPLES) ? size - offset : DECIM_TILE_NSAMPLES;
+        #ifdef ADC_BITPLANES
+            int* tile_in[ADC_NBITS_MAX];
+            for (int b=0; b<ctx->config.adc_nbits; b++) {
+                tile_in[b] = in[b] + offset;
+            }
+        #else
+            adc_out_t tile_in = in + offset;
+        #endif // ADC_BITPLANES
+        dfiltModuleChunk(tile_in, tile, n, ctx);
+        decimModuleChunk(tile, out + (offset >> osr_log), n, ctx);
     }
 
     return 0;
 
-}
\ No newline at end of file
+}
@@ -10,32 +10,55 @@
 #include "../include/dfilt.h"
 
 
-int dfiltModule(int** in, int* out) {
-
-    // Convert input to single int value
-    int* in_signed = malloc(ADC_NSAMPLES * sizeof(int));
-    for (int i=0; i<ADC_NSAMPLES; i++) {
-        in_signed[i] = - (1 << (ADC_NBITS-1));
-        for (int n=0; n<ADC_NBITS; n++) {
-            in_signed[i] += in[n][i] * (1 << (ADC_NBITS - 1 - n));
+int dfiltModule(adc_out_t in, int* out, afe_ctx_t* ctx) {
+
+    return dfiltModuleChunk(in, out, ctx->adc_nsamples, ctx);
+}
+
+int dfiltModuleChunk(adc_out_t in, int* out, int size, afe_ctx_t* ctx) {
+
+    chain_state_t* state = &ctx->chain_state;
+    dfilt_coefs_t* coefs = &ctx->dfilt_coefs;
+    int nbits = ctx->config.adc_nbits;
+
+    // Convert input to single signed int value (filtered in place)
+    #ifdef ADC_BITPLANES
+        for (int i=0; i<size; i++) {
+            out[i] = - (1 << (nbits-1));
+            for (int n=0; n<nbits; n++) {
+                out[i] += in[n][i] * (1 << (nbits - 1 - n));
+            }
+            out[i] = out[i] << (OUT_NBITS - nbits);
+        }
+    #else
+        for (int i=0; i<size; i++) {
+            out[i] = ((int)in[i] - (1 << (nbits-1))) * (1 << (OUT_NBITS - nbits));
         }
-        in_signed[i] = in_signed[i] << (OUT_NBITS - ADC_NBITS);
-    }
+    #endif // ADC_BITPLANES
 
-    // HPF
-    float hpf_alpha[3] = {DFILT_HPF_ALPHA_0, DFILT_HPF_ALPHA_1, DFILT_HPF_ALPHA_2};
-    float hpf_beta[3] = {DFILT_HPF_BETA_0, DFILT_HPF_BETA_1, DFILT_HPF_BETA_2};
-    int* hpf_out = malloc(ADC_NSAMPLES * sizeof(int));
-    iir_order_2_int(in_signed, hpf_out, ADC_NSAMPLES, hpf_alpha, hpf_beta);
+    #ifdef DFILT_FIXED
+        // HPF
+        int64_t hpf_alpha_fixed[3], hpf_beta_fixed[3];
+        iir_order_2_fixed_coefs(coefs->hpf_alpha, coefs->hpf_beta, DFILT_COEF_FRAC, hpf_alpha_fixed, hpf_beta_fixed);
+        iir_order_2_fixed_chunk(out, out, size, hpf_alpha_fixed, hpf_beta_fixed, &state->dfilt_hpf_fixed);
 
-    // LPF
-    float lpf_alpha[3] = {DFILT_LPF_ALPHA_0, DFILT_LPF_ALPHA_1, DFILT_LPF_ALPHA_2};
-    float lpf_beta[3] = {DFILT_LPF_BETA_0, DFILT_LPF_BETA_1, DFILT_LPF_BETA_2};
-    iir_order_2_int(hpf_out, out, ADC_NSAMPLES, lpf_alpha, lpf_beta);
+        // LPF
+        int64_t lpf_alpha_fixed[3], lpf_beta_fixed[3];
+        iir_order_2_fixed_coefs(coefs->lpf_alpha, coefs->lpf_beta, DFILT_COEF_FRAC, lpf_alpha_fixed, lpf_beta_fixed);
+        iir_order_2_fixed_chunk(out, out, size, lpf_alpha_fixed, lpf_beta_fixed, &state->dfilt_lpf_fixed);
+    #else
+        // HPF
+        float hpf_alpha[3] = {(float)coefs->hpf_alpha[0], (float)coefs->hpf_alpha[1], (float)coefs->hpf_alpha[2]};
+        float hpf_beta[3] = {(float)coefs->hpf_beta[0], (float)coefs->hpf_beta[1], (float)coefs->hpf_beta[2]};
+        iir_order_2_int_chunk(out, out, size, hpf_alpha, hpf_beta, &state->dfilt_hpf);
 
-    free(in_signed);
-    free(hpf_out);
+        // LPF
+        float lpf_alpha[3] = {(float)coefs->lpf_alpha[0], (float)coefs->lpf_alpha[1], (float)coefs->lpf_alpha[2]};
+        float lpf_beta[3] = {(float)coefs->lpf_beta[0], (float)coefs->lpf_beta[1], (float)coefs->lpf_beta[2]};
+        iir_order_2_int_chunk(out, out, size, lpf_alpha, lpf_beta, &state->dfilt_lpf);
+    #endif // DFILT_FIXED
 
     return 0;
 }
 
+
@@ -8,35 +8,62 @@
 #include "../include/setup.h"
 #include "../include/utils.h"
 #include "../include/ia.h"
+#include "../include/noise_bank.h"
 
-int iaModule(float* in1d, float* in2d, float* in1c, float* in2c, float* out) {
+int iaModule(float* in1d, float* in2d, float* in1c, float* in2c, float* out, afe_ctx_t* ctx) {
 
     // Generate noise
     #ifdef NOISY
-        float enbw[2] = {FL, FH};
-        float* v_noise = malloc(N_SAMPLES * sizeof(float));
-        mixed_noise_generator_nsamples(v_noise, IA_NOISE * IA_NOISE, IA_FCORNER, enbw);
+        ia_noise_generator(ctx->iaNoise, ctx->analog_nsamples, ctx);
     #endif // NOISY
+    iaModuleChunk(in1d, in2d, in1c, in2c, ctx->iaNoise, out, ctx->analog_nsamples, ctx);
 
-    // Compute output
-    float* v_intermediate = malloc(N_SAMPLES * sizeof(float));
-    #ifdef NOISY
-        for (int i=0; i<N_SAMPLES; i++) {
-            v_intermediate[i] = IA_GAIN * ((in1d[i] + in2d[i])/2 + (in1c[i] + in2c[i])/2/IA_CMRR + v_noise[i]);
+    return 0;
+
+}
+
+int iaModuleChunk(float* in1d, float* in2d, float* in1c, float* in2c, float* noise, float* out, int size, afe_ctx_t* ctx) {
+
+    float gain = ctx->config.ia_gain;
+    float cm_factor = 0.5f / ctx->config.ia_cmrr; // CM signal averaged then attenuated by the CMRR
+
+    // Compute output (filtered in place)
+    #ifdef COLLAPSE_LINEAR
+        // in1d and in1c already hold the averages of the two inputs
+        for (int i=0; i<size; i++) {
+            #ifdef NOISY
+                out[i] = gain * (in1d[i] + in1c[i] * (2 * cm_factor) + noise[i]);
+            #else
+                out[i] = gain * (in1d[i] + in1c[i] * (2 * cm_factor));
+            #endif // NOISY
+        }
+    #elif defined(NOISY)
+        for (int i=0; i<size; i++) {
+            out[i] = gain * ((in1d[i] + in2d[i])/2 + (in1c[i] + in2c[i]) * cm_factor + noise[i]);
         }
-        free(v_noise);
     #else
-        for (int i=0; i<N_SAMPLES; i++) {
-            v_intermediate[i] = IA_GAIN * ((in1d[i] + in2d[i])/2 + (in1c[i] + in2c[i])/2/IA_CMRR);
+        for (int i=0; i<size; i++) {
+            out[i] = gain * ((in1d[i] + in2d[i])/2 + (in1c[i] + in2c[i]) * cm_factor);
         }
-    #endif // NOISY
+    #endif // COLLAPSE_LINEAR, NOISY
 
     // Filter output
-    float alpha[2] = {IA_ALPHA_0, IA_ALPHA_1};
-    float beta[2] = {IA_BETA_0, IA_BETA_1};
-    iir_order_1(v_intermediate, out, N_SAMPLES, alpha, beta);
-    free(v_intermediate);
+    iir_order_1_chunk(out, out, size, ctx->analog_coefs.ia_alpha, ctx->analog_coefs.ia_beta, &ctx->chain_state.ia);
 
     return 0;
 
 }
+
+int ia_noise_generator(float* noise, int size, afe_ctx_t* ctx) {
+
+    #ifdef NOISE_BANK
+        return noise_bank_chunk(noise, size, &ctx->noise_bank, RNG_STREAM_IA);
+    #endif // NOISE_BANK
+    #ifdef NOISE_SYNTH
+        return noise_synth_chunk(noise, size, &ctx->noise_synth[RNG_STREAM_IA], &ctx->rng[RNG_STREAM_IA]);
+    #endif // NOISE_SYNTH
+    float enbw[2] = {FL, FH};
+    float power = ctx->config.ia_noise * ctx->config.ia_noise;
+    return mixed_noise_generator_chunk(noise, size, ctx->analog_fs, power, ctx->config.ia_fcorner, enbw, &ctx->chain_state.ia_pink, &ctx->rng[RNG_STREAM_IA]);
+
+}
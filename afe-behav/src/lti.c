@@ -0,0 +1,229 @@
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "../include/setup.h"
+#include "../include/utils.h"
+#include "../include/ia.h"
+#include "../include/lti.h"
+
+// Filters h in place with a 1st- or 2nd-order IIR filter, in double
+static void iir_double(double* h, int size, int order, float* alpha, float* beta) {
+
+    double a1 = alpha[1] / alpha[0];
+    double a2 = (order > 1) ? alpha[2] / alpha[0] : 0.0;
+    double b0 = beta[0] / alpha[0];
+    double b1 = beta[1] / alpha[0];
+    double b2 = (order > 1) ? beta[2] / alpha[0] : 0.0;
+    double x1 = 0.0, x2 = 0.0, y1 = 0.0, y2 = 0.0;
+    for (int i=0; i<size; i++) {
+        double y0 = b0 * h[i] + b1 * x1 + b2 * x2 - a1 * y1 - a2 * y2;
+        x2 = x1;
+        x1 = h[i];
+        y2 = y1;
+        y1 = y0;
+        h[i] = y0;
+    }
+}
+
+// Length of h above tol times its peak
+static int significant_length(double* h, int size, double tol) {
+
+    double peak = 0.0;
+    for (int i=0; i<size; i++) {
+        peak = (fabs(h[i]) > peak) ? fabs(h[i]) : peak;
+    }
+    int length = 1;
+    for (int i=0; i<size; i++) {
+        if (fabs(h[i]) > tol * peak) {
+            length = i + 1;
+        }
+    }
+    return length;
+}
+
+// Index of the bin -k of the bin k at index p of a spectrum in bit-reversed order (index 3h-1-p for p in [h, 2h))
+static int mirror_index(int p) {
+
+    int h = 1;
+    while (2 * h <= p) {
+        h <<= 1;
+    }
+    return (p == 0) ? 0 : 3 * h - 1 - p;
+}
+
+// Output spectrum Y = A * Z + B * conj(Z[-k]) at the indices p0 to p0+size-1 of the spectra in bit-reversed order,
+// whose mirrors run backwards from m0
+static void spectrum_product(lti_fft_t* lti, int p0, int m0, int size) {
+
+    float* a_re = lti->a_re + p0;
+    float* a_im = lti->a_im + p0;
+    float* b_re = lti->b_re + p0;
+    float* b_im = lti->b_im + p0;
+    float* z_re = lti->z_re + p0;
+    float* z_im = lti->z_im + p0;
+    float* zm_re = lti->z_re + m0;
+    float* zm_im = lti->z_im + m0;
+    float* y_re = lti->y_re + p0;
+    float* y_im = lti->y_im + p0;
+    for (int j=0; j<size; j++) {
+        float zmr = zm_re[-j];
+        float zmi = -zm_im[-j];
+        y_re[j] = a_re[j] * z_re[j] - a_im[j] * z_im[j] + b_re[j] * zmr - b_im[j] * zmi;
+        y_im[j] = a_re[j] * z_im[j] + a_im[j] * z_re[j] + b_re[j] * zmi + b_im[j] * zmr;
+    }
+}
+
+int ltiInit(afe_ctx_t* ctx) {
+
+    lti_fft_t* lti = &ctx->lti;
+    analog_coefs_t* coefs = &ctx->analog_coefs;
+    double gain = (double)ctx->config.ia_gain * ctx->config.afilt_gain;
+
+    // Impulse responses of the signal path (PCB, IA, AFILT LPF) and of the noise path (IA, AFILT LPF)
+    int nmax = LTI_FFT_MAX_NFFT / 2;
+    double* h = (double*)calloc(nmax, sizeof(double));
+    double* h_noise = (double*)calloc(nmax, sizeof(double));
+    if (h == NULL || h_noise == NULL) {
+        free(h);
+        free(h_noise);
+        return 1;
+    }
+    h[0] = gain;
+    h_noise[0] = gain;
+    iir_double(h, nmax, 1, coefs->pcb_alpha, coefs->pcb_beta);
+    iir_double(h, nmax, 1, coefs->ia_alpha, coefs->ia_beta);
+    iir_double(h, nmax, 2, coefs->afilt_lpf_alpha, coefs->afilt_lpf_beta);
+    iir_double(h_noise, nmax, 1, coefs->ia_alpha, coefs->ia_beta);
+    iir_double(h_noise, nmax, 2, coefs->afilt_lpf_alpha, coefs->afilt_lpf_beta);
+
+    // FFT of at least twice the impulse responses, so that segments hold at least as many new samples as history
+    int ntaps = significant_length(h, nmax, LTI_FFT_TOL);
+    int ntaps_noise = significant_length(h_noise, nmax, LTI_FFT_TOL);
+    lti->ntaps = (ntaps > ntaps_noise) ? ntaps : ntaps_noise;
+    if (lti->ntaps == nmax) {
+        fprintf(stderr, "LTI FFT filter: impulse response truncated to %d samples\n", nmax);
+    }
+    lti->nfft = 2;
+    while (lti->nfft < 2 * lti->ntaps) {
+        lti->nfft <<= 1;
+    }
+
+    int nfft = lti->nfft;
+    lti->a_re = (float*)malloc(nfft * sizeof(float));
+    lti->a_im = (float*)malloc(nfft * sizeof(float));
+    lti->b_re = (float*)malloc(nfft * sizeof(float));
+    lti->b_im = (float*)malloc(nfft * sizeof(float));
+    lti->tw_re = (float*)malloc(nfft * sizeof(float));
+    lti->tw_im = (float*)malloc(nfft * sizeof(float));
+    lti->z_re = (float*)malloc(nfft * sizeof(float));
+    lti->z_im = (float*)malloc(nfft * sizeof(float));
+    lti->y_re = (float*)malloc(nfft * sizeof(float));
+    lti->y_im = (float*)malloc(nfft * sizeof(float));
+    lti->hist = (float*)calloc(lti->ntaps, sizeof(float));
+    lti->hist_noise = (float*)calloc(lti->ntaps, sizeof(float));
+    if (lti->a_re == NULL || lti->a_im == NULL || lti->b_re == NULL || lti->b_im == NULL || lti->tw_re == NULL || lti->tw_im == NULL
+        || lti->z_re == NULL || lti->z_im == NULL || lti->y_re == NULL || lti->y_im == NULL || lti->hist == NULL || lti->hist_noise == NULL) {
+        free(h);
+        free(h_noise);
+        return 1;
+    }
+    fft_init(lti->tw_re, lti->tw_im, nfft);
+
+    // Spectra of both paths, computed together as the real and imaginary parts of one FFT
+    for (int i=0; i<nfft; i++) {
+        lti->z_re[i] = (i < lti->ntaps) ? (float)h[i] : 0.0f;
+        lti->z_im[i] = (i < lti->ntaps) ? (float)h_noise[i] : 0.0f;
+    }
+    free(h);
+    free(h_noise);
+    fft_forward(lti->z_re, lti->z_im, nfft, lti->tw_re, lti->tw_im);
+
+    // With Z the FFT of (signal + i*noise) and Zm[k] = conj(Z[-k]), the spectrum of the output is
+    //     Y = Hs * (Z + Zm) / 2 - i * Hn * (Z - Zm) / 2 = A * Z + B * Zm
+    // with A = (Hs - i*Hn) / 2 and B = (Hs + i*Hn) / 2, scaled by 1/nfft for the inverse FFT
+    float scale = 0.5f / nfft;
+    for (int k=0; k<nfft; k++) {
+        int km = mirror_index(k);
+        float hs_re = (lti->z_re[k] + lti->z_re[km]) / 2;
+        float hs_im = (lti->z_im[k] - lti->z_im[km]) / 2;
+        float hn_re = (lti->z_im[k] + lti->z_im[km]) / 2;
+        float hn_im = (lti->z_re[km] - lti->z_re[k]) / 2;
+        lti->a_re[k] = scale * (hs_re + hn_im);
+        lti->a_im[k] = scale * (hs_im - hn_re);
+        lti->b_re[k] = scale * (hs_re - hn_im);
+        lti->b_im[k] = scale * (hs_im + hn_re);
+    }
+
+    return 0;
+}
+
+int ltiModule(float* in1d, float* in2d, float* in1c, float* in2c, float* out, afe_ctx_t* ctx) {
+
+    // Generate noise
+    #ifdef NOISY
+        ia_noise_generator(ctx->iaNoise, ctx->analog_nsamples, ctx);
+    #endif // NOISY
+    ltiModuleChunk(in1d, in2d, in1c, in2c, ctx->iaNoise, out, ctx->analog_nsamples, ctx);
+
+    return 0;
+
+}
+
+int ltiModuleChunk(float* in1d, float* in2d, float* in1c, float* in2c, float* noise, float* out, int size, afe_ctx_t* ctx) {
+
+    lti_fft_t* lti = &ctx->lti;
+    int nfft = lti->nfft;
+    int nhist = lti->ntaps - 1;
+    int segment_max = nfft - nhist;
+    float cm_factor = 0.5f / ctx->config.ia_cmrr; // CM signal averaged then attenuated by the CMRR
+
+    int n;
+    for (int offset=0; offset<size; offset+=n) {
+        n = (size - offset < segment_max) ? size - offset : segment_max;
+
+        // IA input (signal + i*noise): history, then the new samples of the segment, then zeros
+        memcpy(lti->z_re, lti->hist, nhist * sizeof(float));
+        memcpy(lti->z_im, lti->hist_noise, nhist * sizeof(float));
+        float* z_re = lti->z_re + nhist;
+        float* z_im = lti->z_im + nhist;
+        for (int i=0; i<n; i++) {
+            #ifdef COLLAPSE_LINEAR
+                // in1d and in1c already hold the averages of the two inputs
+                z_re[i] = in1d[offset + i] + in1c[offset + i] * (2 * cm_factor);
+            #else
+                z_re[i] = (in1d[offset + i] + in2d[offset + i])/2 + (in1c[offset + i] + in2c[offset + i]) * cm_factor;
+            #endif // COLLAPSE_LINEAR
+            #ifdef NOISY
+                z_im[i] = noise[offset + i];
+            #else
+                z_im[i] = 0.0f;
+            #endif // NOISY
+        }
+        for (int i=nhist+n; i<nfft; i++) {
+            lti->z_re[i] = 0.0f;
+            lti->z_im[i] = 0.0f;
+        }
+        memcpy(lti->hist, lti->z_re + n, nhist * sizeof(float));
+        memcpy(lti->hist_noise, lti->z_im + n, nhist * sizeof(float));
+
+        // Y = A * Z + B * conj(Z[-k]), spectra in bit-reversed order, by blocks of indices [h, 2h) mirrored onto themselves
+        fft_forward(lti->z_re, lti->z_im, nfft, lti->tw_re, lti->tw_im);
+        spectrum_product(lti, 0, 0, 1);
+        for (int h=1; h<nfft; h<<=1) {
+            spectrum_product(lti, h, 2 * h - 1, h);
+        }
+        fft_inverse(lti->y_re, lti->y_im, nfft, lti->tw_re, lti->tw_im);
+
+        // Outputs past the history are free of circular wrap-around
+        for (int i=0; i<n; i++) {
+            out[offset + i] = lti->y_re[nhist + i];
+        }
+    }
+
+    return 0;
+
+}
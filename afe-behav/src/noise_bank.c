@@ -0,0 +1,234 @@
+// mmap and fstat are POSIX, not C99
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <inttypes.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../include/setup.h"
+#include "../include/utils.h"
+#include "../include/noise_bank.h"
+
+#define NOISE_BANK_MAGIC "AFENB002" // Version of the file format and of the generators, a new one regenerates the banks
+
+// Header of a bank file, followed by the rings of white then pink noise of each source
+typedef struct {
+    char        magic[8];
+    uint64_t    seed;
+    int32_t     analog_fs;
+    int32_t     nbuffers;
+    int64_t     nsamples;   // samples of each ring
+} noise_bank_header_t;
+
+// Header and file name of the bank of a configuration
+static int noise_bank_header(const afe_config_t* config, noise_bank_header_t* header, char* filename, size_t filename_size) {
+
+    if (config->analog_fs_ratio <= 0 || N_SAMPLES % config->analog_fs_ratio != 0) {
+        fprintf(stderr, "Noise bank: invalid analog rate ratio %d\n", config->analog_fs_ratio);
+        return 1;
+    }
+    if (config->noise_bank_nbuffers < 1) {
+        fprintf(stderr, "Noise bank: invalid number of buffers %d\n", config->noise_bank_nbuffers);
+        return 1;
+    }
+    *header = (noise_bank_header_t){0};
+    memcpy(header->magic, NOISE_BANK_MAGIC, sizeof(header->magic));
+    header->seed = config->seed;
+    header->analog_fs = FS / config->analog_fs_ratio;
+    header->nbuffers = config->noise_bank_nbuffers;
+    header->nsamples = (int64_t) config->noise_bank_nbuffers * (N_SAMPLES / config->analog_fs_ratio);
+    snprintf(filename, filename_size, "%s%s_%" PRIu64 "_%d_%d.bin", config->run_folder, NOISE_BANK_NAME, header->seed, header->analog_fs,
+        header->nbuffers);
+
+    return 0;
+}
+
+// 1 if the file holds a complete bank with the given header
+static int noise_bank_valid(const char* filename, const noise_bank_header_t* header) {
+
+    FILE* file = fopen(filename, "rb");
+    if (file == NULL) {
+        return 0;
+    }
+    noise_bank_header_t file_header;
+    int valid = (fread(&file_header, sizeof(file_header), 1, file) == 1 && memcmp(&file_header, header, sizeof(file_header)) == 0);
+    if (valid) {
+        // Complete: 2 rings per source after the header
+        long size = sizeof(file_header) + 2 * N_RNG_STREAMS * header->nsamples * (long) sizeof(float);
+        valid = (fseek(file, 0, SEEK_END) == 0 && ftell(file) == size);
+    }
+    fclose(file);
+
+    return valid;
+}
+
+int noise_bank_build(const afe_config_t* config) {
+
+    noise_bank_header_t header;
+    char filename[CONFIG_LINE_MAX];
+    if (noise_bank_header(config, &header, filename, sizeof(filename)) != 0) {
+        return 1;
+    }
+    if (noise_bank_valid(filename, &header)) {
+        return 0;
+    }
+
+    printf("Generating noise bank %s\n", filename);
+    char tmp_filename[CONFIG_LINE_MAX + 4];
+    snprintf(tmp_filename, sizeof(tmp_filename), "%s.tmp", filename);
+    FILE* file = fopen(tmp_filename, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "Noise bank: Error opening file %s\n", tmp_filename);
+        return 1;
+    }
+
+    // One buffer at a time, each ring drawn from its own stream (subject index past the last subject, not used by the runs)
+    int buffer_nsamples = (int) (header.nsamples / header.nbuffers);
+    int nfade = (NOISE_BANK_NFADE < buffer_nsamples) ? NOISE_BANK_NFADE : buffer_nsamples;
+    float* buffer = (float*)malloc(buffer_nsamples * sizeof(float));
+    float* head = (float*)malloc(nfade * sizeof(float));
+    int write_res = (buffer == NULL || head == NULL || fwrite(&header, sizeof(header), 1, file) != 1);
+    rng_t rng;
+    for (int k=0; k<N_RNG_STREAMS && write_res == 0; k++) {
+        rng_seed(&rng, config->seed, NSUBJECTS, RNG_BUFFER_ALL, 2 * k);
+        for (int b=0; b<header.nbuffers && write_res == 0; b++) {
+            gaussian_generator(buffer, buffer_nsamples, 1.0f, &rng);
+            write_res = (fwrite(buffer, sizeof(float), buffer_nsamples, file) != (size_t) buffer_nsamples);
+        }
+
+        // Pink noise of unit sources, continuous over the ring: the head of the sequence is drawn first and kept, the end of
+        // the ring fades from the sequence into the head (constant power), so that the ring continues into its start
+        rng_seed(&rng, config->seed, NSUBJECTS, RNG_BUFFER_ALL, 2 * k + 1);
+        pink_state_t state;
+        gaussian_generator(state.sources, PINK_NOISE_NSOURCES, 1.0f, &rng);
+        state.running_sum = sumf(state.sources, PINK_NOISE_NSOURCES);
+        state.source_scale = 1.0f;
+        state.key = 0;
+        pink_noise_generator_chunk(head, nfade, &state, &rng);
+        for (int b=0; b<header.nbuffers && write_res == 0; b++) {
+            pink_noise_generator_chunk(buffer, buffer_nsamples, &state, &rng);
+            if (b == header.nbuffers - 1) {
+                float* tail = buffer + buffer_nsamples - nfade;
+                for (int i=0; i<nfade; i++) {
+                    double phase = HALF_PI * (i + 0.5) / nfade;
+                    tail[i] = (float) (cos(phase) * tail[i] + sin(phase) * head[i]);
+                }
+            }
+            write_res = (fwrite(buffer, sizeof(float), buffer_nsamples, file) != (size_t) buffer_nsamples);
+        }
+    }
+    free(buffer);
+    free(head);
+    if (fclose(file) != 0 || write_res != 0) {
+        fprintf(stderr, "Noise bank: Error writing file %s\n", tmp_filename);
+        remove(tmp_filename);
+        return 1;
+    }
+    // Other processes see either no bank or a complete one
+    if (rename(tmp_filename, filename) != 0) {
+        fprintf(stderr, "Noise bank: Error renaming file %s\n", tmp_filename);
+        remove(tmp_filename);
+        return 1;
+    }
+
+    return 0;
+}
+
+int noise_bank_open(noise_bank_t* bank, const afe_config_t* config) {
+
+    *bank = (noise_bank_t){0};
+    noise_bank_header_t header;
+    char filename[CONFIG_LINE_MAX];
+    if (noise_bank_header(config, &header, filename, sizeof(filename)) != 0) {
+        return 1;
+    }
+    if (!noise_bank_valid(filename, &header)) {
+        fprintf(stderr, "Noise bank: missing or invalid file %s (see noise_bank_build)\n", filename);
+        return 1;
+    }
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Noise bank: Error opening file %s\n", filename);
+        return 1;
+    }
+    size_t map_size = sizeof(header) + 2 * N_RNG_STREAMS * header.nsamples * sizeof(float);
+    void* map = mmap(NULL, map_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Noise bank: Error mapping file %s\n", filename);
+        return 1;
+    }
+
+    bank->map = map;
+    bank->map_size = map_size;
+    bank->nsamples = header.nsamples;
+    const float* rings = (const float*) ((const char*) map + sizeof(header));
+    for (int k=0; k<N_RNG_STREAMS; k++) {
+        bank->white[k] = rings + (2 * k) * header.nsamples;
+        bank->pink[k] = rings + (2 * k + 1) * header.nsamples;
+    }
+
+    return 0;
+}
+
+int noise_bank_close(noise_bank_t* bank) {
+
+    if (bank->map != NULL) {
+        munmap(bank->map, bank->map_size);
+    }
+    *bank = (noise_bank_t){0};
+
+    return 0;
+}
+
+int noise_bank_set_power(noise_bank_t* bank, int source, int fs, float power, float fcorner, float* power_band) {
+
+    return mixed_noise_scales(fs, power, fcorner, power_band, &bank->white_scale[source], &bank->pink_scale[source]);
+}
+
+int noise_bank_seek(noise_bank_t* bank, uint64_t seed, uint32_t subject_idx, uint32_t buffer_idx) {
+
+    // Any sample of the rings, drawn (64 bits) from a stream past the noise sources of the buffer
+    if (bank->nsamples == 0) {
+        return 0;
+    }
+    rng_t rng;
+    rng_seed(&rng, seed, subject_idx, buffer_idx, N_RNG_STREAMS);
+    uint64_t draw = rng_uint32(&rng);
+    draw = (draw << 32) | rng_uint32(&rng);
+    int64_t start = (int64_t) (draw % (uint64_t) bank->nsamples);
+    for (int k=0; k<N_RNG_STREAMS; k++) {
+        bank->pos[k] = start;
+    }
+
+    return 0;
+}
+
+int noise_bank_chunk(float* noise, int size, noise_bank_t* bank, int source) {
+
+    const float* white = bank->white[source];
+    const float* pink = bank->pink[source];
+    float white_scale = bank->white_scale[source];
+    float pink_scale = bank->pink_scale[source];
+    int64_t pos = bank->pos[source];
+    int n;
+    for (int offset=0; offset<size; offset+=n) {
+        n = (size - offset < bank->nsamples - pos) ? size - offset : (int) (bank->nsamples - pos);
+        for (int i=0; i<n; i++) {
+            noise[offset + i] = white_scale * white[pos + i] + pink_scale * pink[pos + i];
+        }
+        pos = (pos + n == bank->nsamples) ? 0 : pos + n;
+    }
+    bank->pos[source] = pos;
+
+    return 0;
+}
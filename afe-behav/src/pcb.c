@@ -10,15 +10,34 @@
 #include "../include/pcb.h"
 
 
-int pcbModule(float* in1d, float* in2d, float* in1c, float* in2c, float* out1d, float* out2d, float* out1c, float* out2c) {
+int pcbModule(float* in1d, float* in2d, float* in1c, float* in2c, float* out1d, float* out2d, float* out1c, float* out2c, afe_ctx_t* ctx) {
 
-    float alpha[2] = {PCB_ALPHA_0, PCB_ALPHA_1};
-    float beta[2] = {PCB_BETA_0, PCB_BETA_1};
+    return pcbModuleChunk(in1d, in2d, in1c, in2c, out1d, out2d, out1c, out2c, ctx->analog_nsamples, ctx);
 
-    iir_order_1(in1d, out1d, N_SAMPLES, alpha, beta);
-    iir_order_1(in2d, out2d, N_SAMPLES, alpha, beta);
-    iir_order_1(in1c, out1c, N_SAMPLES, alpha, beta);
-    iir_order_1(in2c, out2c, N_SAMPLES, alpha, beta);
+}
+
+int pcbModuleChunk(float* in1d, float* in2d, float* in1c, float* in2c, float* out1d, float* out2d, float* out1c, float* out2c, int size, afe_ctx_t* ctx) {
+
+    float* a = ctx->analog_coefs.pcb_alpha;
+    float* b = ctx->analog_coefs.pcb_beta;
+
+    // Only the averages of the inputs (in1d, in1c) are filtered
+    #ifdef COLLAPSE_LINEAR
+        float* in_avg[2] = {in1d, in1c};
+        float* out_avg[2] = {out1d, out1c};
+        float alpha_avg[4] = {a[0], a[1], a[0], a[1]};
+        float beta_avg[4] = {b[0], b[1], b[0], b[1]};
+        iir_order_1_multi(in_avg, out_avg, 2, size, alpha_avg, beta_avg, ctx->chain_state.pcb);
+        return 0;
+    #endif // COLLAPSE_LINEAR
+
+    // Same filter on the four inputs, filtered together in SIMD lanes
+    float alpha[8] = {a[0], a[1], a[0], a[1], a[0], a[1], a[0], a[1]};
+    float beta[8] = {b[0], b[1], b[0], b[1], b[0], b[1], b[0], b[1]};
+    float* in[4] = {in1d, in2d, in1c, in2c};
+    float* out[4] = {out1d, out2d, out1c, out2c};
+
+    iir_order_1_multi(in, out, 4, size, alpha, beta, ctx->chain_state.pcb);
 
     return 0;
 
@@ -0,0 +1,187 @@
+// clock_gettime is POSIX, not C99
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+
+#include "../include/setup.h"
+#include "../include/utils.h"
+#include "../include/profile.h"
+
+static const char* stage_names[N_STAGES] = {"stimuli", "pcb", "ia", "lti", "afilt", "adc", "dfilt", "decim", "dfilt_decim", "write"};
+
+double profile_now(void) {
+
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + 1e-9 * t.tv_nsec;
+}
+
+int profile_init(profile_t* profile, int nthreads) {
+
+    *profile = (profile_t){0};
+    profile->nthreads = nthreads;
+    profile->buffers = (profile_buffer_t*)calloc(NSUBJECTS * N_BUFFERS, sizeof(profile_buffer_t));
+    profile->done = (char*)calloc(NSUBJECTS * N_BUFFERS, sizeof(char));
+    if (profile->buffers == NULL || profile->done == NULL) {
+        return 1;
+    }
+
+    return 0;
+}
+
+int profile_free(profile_t* profile) {
+
+    free(profile->buffers);
+    free(profile->done);
+    *profile = (profile_t){0};
+
+    return 0;
+}
+
+profile_buffer_t* profile_buffer(profile_t* profile, int subject_idx, int buffer_idx) {
+
+    if (profile == NULL) {
+        return NULL;
+    }
+    profile->done[subject_idx * N_BUFFERS + buffer_idx] = 1;
+
+    return &profile->buffers[subject_idx * N_BUFFERS + buffer_idx];
+}
+
+// Sum of the timings of the buffers of a subject, or of all subjects if subject_idx is negative
+static void profile_sum(profile_t* profile, int subject_idx, profile_buffer_t* sum, int* nbuffers) {
+
+    *sum = (profile_buffer_t){0};
+    *nbuffers = 0;
+    for (int s=0; s<NSUBJECTS; s++) {
+        if (subject_idx >= 0 && s != subject_idx) {
+            continue;
+        }
+        for (int b=0; b<N_BUFFERS; b++) {
+            if (!profile->done[s * N_BUFFERS + b]) {
+                continue;
+            }
+            profile_buffer_t* buffer = &profile->buffers[s * N_BUFFERS + b];
+            for (int k=0; k<N_STAGES; k++) {
+                sum->seconds[k] += buffer->seconds[k];
+                sum->nsamples[k] += buffer->nsamples[k];
+            }
+            sum->nsignal += buffer->nsignal;
+            (*nbuffers)++;
+        }
+    }
+}
+
+// Stages of a sum of timings as a JSON object, only the stages that ran
+static void write_stages_json(FILE* file, profile_buffer_t* sum, const char* indent) {
+
+    double total = 0.0;
+    for (int k=0; k<N_STAGES; k++) {
+        total += sum->seconds[k];
+    }
+    fprintf(file, "{\n");
+    int first = 1;
+    for (int k=0; k<N_STAGES; k++) {
+        if (sum->nsamples[k] == 0) {
+            continue;
+        }
+        fprintf(file, "%s\n%s    \"%s\": {\"seconds\": %.6f, \"share\": %.4f, \"samples\": %" PRId64 ", \"samples_per_second\": %.6g}",
+                first ? "" : ",", indent, stage_names[k], sum->seconds[k], (total > 0) ? sum->seconds[k] / total : 0.0, sum->nsamples[k],
+                (sum->seconds[k] > 0) ? sum->nsamples[k] / sum->seconds[k] : 0.0);
+        first = 0;
+    }
+    fprintf(file, "\n%s}", indent);
+}
+
+int profile_report(profile_t* profile, const afe_config_t* config) {
+
+    profile_buffer_t total;
+    int nbuffers;
+    profile_sum(profile, -1, &total, &nbuffers);
+    double busy_seconds = 0.0;
+    for (int k=0; k<N_STAGES; k++) {
+        busy_seconds += total.seconds[k];
+    }
+    double signal_seconds = (double)total.nsignal / FS;
+    double realtime_factor = (profile->wall_seconds > 0) ? signal_seconds / profile->wall_seconds : 0.0;
+
+    // Summary
+    printf("Profile: %d buffers, %.3f s of signal in %.3f s on %d threads, real-time factor %.2f\n",
+           nbuffers, signal_seconds, profile->wall_seconds, profile->nthreads, realtime_factor);
+    printf("    %-12s %10s %7s %14s\n", "stage", "seconds", "share", "samples/s");
+    for (int k=0; k<N_STAGES; k++) {
+        if (total.nsamples[k] > 0) {
+            printf("    %-12s %10.3f %6.1f%% %14.4g\n", stage_names[k], total.seconds[k],
+                   (busy_seconds > 0) ? 100 * total.seconds[k] / busy_seconds : 0.0, (total.seconds[k] > 0) ? total.nsamples[k] / total.seconds[k] : 0.0);
+        }
+    }
+
+    // Per buffer, seconds per stage
+    char filename[200];
+    snprintf(filename, sizeof(filename), "%s%s/profile.csv", config->run_folder, config->run_category);
+    FILE* file = fopen(filename, "w");
+    if (file == NULL) {
+        fprintf(stderr, "Profile report: Error opening file %s\n", filename);
+        return 1;
+    }
+    fprintf(file, "subject,buffer,signal_seconds");
+    for (int k=0; k<N_STAGES; k++) {
+        fprintf(file, ",%s_seconds", stage_names[k]);
+    }
+    fprintf(file, "\n");
+    for (int s=0; s<NSUBJECTS; s++) {
+        for (int b=0; b<N_BUFFERS; b++) {
+            if (!profile->done[s * N_BUFFERS + b]) {
+                continue;
+            }
+            profile_buffer_t* buffer = &profile->buffers[s * N_BUFFERS + b];
+            fprintf(file, "%s,%d,%.6f", subject_list[s], b+1, (double)buffer->nsignal / FS);
+            for (int k=0; k<N_STAGES; k++) {
+                fprintf(file, ",%.6f", buffer->seconds[k]);
+            }
+            fprintf(file, "\n");
+        }
+    }
+    fclose(file);
+
+    // Per stage, overall and per subject
+    snprintf(filename, sizeof(filename), "%s%s/profile.json", config->run_folder, config->run_category);
+    file = fopen(filename, "w");
+    if (file == NULL) {
+        fprintf(stderr, "Profile report: Error opening file %s\n", filename);
+        return 1;
+    }
+    fprintf(file, "{\n    \"nthreads\": %d,\n    \"nbuffers\": %d,\n", profile->nthreads, nbuffers);
+    fprintf(file, "    \"wall_seconds\": %.6f,\n    \"busy_seconds\": %.6f,\n", profile->wall_seconds, busy_seconds);
+    fprintf(file, "    \"signal_seconds\": %.6f,\n    \"realtime_factor\": %.4f,\n", signal_seconds, realtime_factor);
+    fprintf(file, "    \"stages\": ");
+    write_stages_json(file, &total, "    ");
+    fprintf(file, ",\n    \"subjects\": {");
+    int first = 1;
+    for (int s=0; s<NSUBJECTS; s++) {
+        profile_buffer_t sum;
+        profile_sum(profile, s, &sum, &nbuffers);
+        if (nbuffers == 0) {
+            continue;
+        }
+        double subject_seconds = 0.0;
+        for (int k=0; k<N_STAGES; k++) {
+            subject_seconds += sum.seconds[k];
+        }
+        fprintf(file, "%s\n        \"%s\": {\n            \"nbuffers\": %d,\n            \"busy_seconds\": %.6f,\n            \"signal_seconds\": %.6f,\n            \"stages\": ",
+                first ? "" : ",", subject_list[s], nbuffers, subject_seconds, (double)sum.nsignal / FS);
+        write_stages_json(file, &sum, "            ");
+        fprintf(file, "\n        }");
+        first = 0;
+    }
+    fprintf(file, "\n    }\n}\n");
+    fclose(file);
+
+    return 0;
+}
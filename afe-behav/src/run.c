@@ -0,0 +1,714 @@
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+
+#include "../include/setup.h"
+#include "../include/utils.h"
+#include "../include/stimuli.h"
+#include "../include/pcb.h"
+#include "../include/ia.h"
+#include "../include/lti.h"
+#include "../include/afilt.h"
+#include "../include/adc.h"
+#include "../include/dfilt.h"
+#include "../include/decim.h"
+#include "../include/afe_ctx.h"
+#include "../include/profile.h"
+#include "../include/noise_bank.h"
+#include "../include/run.h"
+
+// Module chain of run_buffer
+static int run_buffer_chain(afe_ctx_t* ctx, int subject_idx, int buffer_idx, int** out_segment, int* out_nsamples) {
+
+    char* subject = (char*) subject_list[subject_idx];
+    int i = buffer_idx;
+
+    #ifndef CONTINUOUS
+        // Buffers are independent: one noise stream per buffer, so that they can run in any order
+        afe_ctx_seed(ctx, subject_idx, buffer_idx);
+    #endif // CONTINUOUS
+
+    *out_segment = ctx->out;
+    *out_nsamples = OUT_NSAMPLES;
+
+    #ifdef DO_PRINT
+        printf("Buffer %d\n", i+1);
+    #endif
+    #ifdef PROFILE
+        profile_buffer_t* profile = profile_buffer(ctx->profile, subject_idx, buffer_idx);
+    #endif // PROFILE
+    #ifdef CHUNKED
+        stimuli_buffer_t* stimuli_buffer = &ctx->stimuli_buffer;
+        int chunk_size;
+        int segment_offset = 0;
+        int segment_nsamples = N_SAMPLES;
+        #ifdef CONTINUOUS
+            // Only the hop is simulated, the first buffer also simulates its first quarter to let the chain settle
+            segment_offset = (i == 0) ? 0 : HOP_OFFSET;
+            segment_nsamples = HOP_OFFSET + HOP_NSAMPLES - segment_offset;
+            *out_segment = ctx->out + (segment_nsamples - HOP_NSAMPLES) / OUT_FS_RATIO;
+            *out_nsamples = HOP_OUT_NSAMPLES;
+        #endif // CONTINUOUS
+        // States restart at the beginning of a buffer, otherwise they carry on from the previous segment
+        if (segment_offset == 0) {
+            afe_ctx_reset(ctx);
+        }
+        // Offsets and sizes are counted at FS, the analog modules run at FS/analog_fs_ratio
+        int analog_fs_ratio = ctx->config.analog_fs_ratio;
+        #ifdef PROFILE
+            if (profile != NULL) {
+                profile->nsignal += segment_nsamples;
+            }
+        #endif // PROFILE
+        PROFILE_START(t_stimuli);
+        if (stimuliLoadBuffer(i, subject, segment_offset, segment_nsamples, ctx) != 0) {
+            return 1;
+        }
+        PROFILE_STOP(t_stimuli, profile, STAGE_STIMULI, 0);
+        #ifdef NOISY
+            PROFILE_START(t_noise);
+            ia_noise_generator(ctx->iaNoise, segment_nsamples / analog_fs_ratio, ctx);
+            PROFILE_STOP(t_noise, profile, STAGE_IA, 0);
+        #endif // NOISY
+        for (int offset=0; offset<segment_nsamples; offset+=chunk_size) {
+            chunk_size = (segment_nsamples - offset < ctx->config.chunk_nsamples) ? segment_nsamples - offset : ctx->config.chunk_nsamples;
+            int analog_offset = offset / analog_fs_ratio;
+            int analog_size = chunk_size / analog_fs_ratio;
+            int adc_size = chunk_size / ctx->adc_fs_ratio;
+            PROFILE_START(t_stimuli_chunk);
+            stimuliModuleChunk(offset, chunk_size, ctx->in1d, ctx->in2d, ctx);
+            PROFILE_STOP(t_stimuli_chunk, profile, STAGE_STIMULI, analog_size);
+            #ifdef LTI_FFT
+                PROFILE_START(t_lti);
+                ltiModuleChunk(ctx->in1d, ctx->in2d, stimuli_buffer->in1c + analog_offset, stimuli_buffer->in2c + analog_offset, (ctx->iaNoise != NULL) ? ctx->iaNoise + analog_offset : NULL, ctx->iaOut, analog_size, ctx);
+                PROFILE_STOP(t_lti, profile, STAGE_LTI, analog_size);
+            #else
+                PROFILE_START(t_pcb);
+                pcbModuleChunk(ctx->in1d, ctx->in2d, stimuli_buffer->in1c + analog_offset, stimuli_buffer->in2c + analog_offset, ctx->pcbOut1d, ctx->pcbOut2d, ctx->pcbOut1c, ctx->pcbOut2c, analog_size, ctx);
+                PROFILE_STOP(t_pcb, profile, STAGE_PCB, analog_size);
+                PROFILE_START(t_ia);
+                iaModuleChunk(ctx->pcbOut1d, ctx->pcbOut2d, ctx->pcbOut1c, ctx->pcbOut2c, (ctx->iaNoise != NULL) ? ctx->iaNoise + analog_offset : NULL, ctx->iaOut, analog_size, ctx);
+                PROFILE_STOP(t_ia, profile, STAGE_IA, analog_size);
+            #endif // LTI_FFT
+            PROFILE_START(t_afilt);
+            afiltModuleChunk(ctx->iaOut, ctx->afiltOutp, ctx->afiltOutn, analog_size, ctx->adc_stride, ctx);
+            PROFILE_STOP(t_afilt, profile, STAGE_AFILT, analog_size);
+            PROFILE_START(t_adc);
+            adcModuleChunk(ctx->afiltOutp, ctx->afiltOutn, ctx->adcOut, analog_size, ctx->adc_stride, ctx);
+            PROFILE_STOP(t_adc, profile, STAGE_ADC, analog_size);
+            #ifdef DECIM_UNFUSED
+                PROFILE_START(t_dfilt);
+                dfiltModuleChunk(ctx->adcOut, ctx->dfiltOut, adc_size, ctx);
+                PROFILE_STOP(t_dfilt, profile, STAGE_DFILT, adc_size);
+                PROFILE_START(t_decim);
+                decimModuleChunk(ctx->dfiltOut, ctx->out + offset / OUT_FS_RATIO, adc_size, ctx);
+                PROFILE_STOP(t_decim, profile, STAGE_DECIM, adc_size);
+            #else
+                PROFILE_START(t_dfilt_decim);
+                dfiltDecimModuleChunk(ctx->adcOut, ctx->out + offset / OUT_FS_RATIO, adc_size, ctx);
+                PROFILE_STOP(t_dfilt_decim, profile, STAGE_DFILT_DECIM, adc_size);
+            #endif // DECIM_UNFUSED
+        }
+        #ifdef DO_PRINT
+            printf("Applied module chain on %d samples\n", segment_nsamples);
+        #endif
+    #else
+        // A full buffer starts from zeroed states
+        afe_ctx_reset(ctx);
+        #ifdef PROFILE
+            if (profile != NULL) {
+                profile->nsignal += N_SAMPLES;
+            }
+        #endif // PROFILE
+        PROFILE_START(t_stimuli);
+        if (stimuliModule(ctx->in1d, ctx->in2d, ctx->in1c, ctx->in2c, i, subject, ctx) != 0) {
+            return 1;
+        }
+        PROFILE_STOP(t_stimuli, profile, STAGE_STIMULI, ctx->analog_nsamples);
+        #ifdef DO_PRINT
+            printf("Generated stimuli\n");
+        #endif
+        #ifdef LTI_FFT
+            PROFILE_START(t_lti);
+            ltiModule(ctx->in1d, ctx->in2d, ctx->in1c, ctx->in2c, ctx->iaOut, ctx);
+            PROFILE_STOP(t_lti, profile, STAGE_LTI, ctx->analog_nsamples);
+            #ifdef DO_PRINT
+                printf("Applied linear path filter\n");
+            #endif
+        #else
+            PROFILE_START(t_pcb);
+            pcbModule(ctx->in1d, ctx->in2d, ctx->in1c, ctx->in2c, ctx->pcbOut1d, ctx->pcbOut2d, ctx->pcbOut1c, ctx->pcbOut2c, ctx);
+            PROFILE_STOP(t_pcb, profile, STAGE_PCB, ctx->analog_nsamples);
+            #ifdef DO_PRINT
+                printf("Applied PCB filtering\n");
+            #endif
+            PROFILE_START(t_ia);
+            iaModule(ctx->pcbOut1d, ctx->pcbOut2d, ctx->pcbOut1c, ctx->pcbOut2c, ctx->iaOut, ctx);
+            PROFILE_STOP(t_ia, profile, STAGE_IA, ctx->analog_nsamples);
+            #ifdef DO_PRINT
+                printf("Applied IA module\n");
+            #endif
+        #endif // LTI_FFT
+        PROFILE_START(t_afilt);
+        afiltModule(ctx->iaOut, ctx->afiltOutp, ctx->afiltOutn, ctx->adc_stride, ctx);
+        PROFILE_STOP(t_afilt, profile, STAGE_AFILT, ctx->analog_nsamples);
+        #ifdef DO_PRINT
+            printf("Applied analog filters module\n");
+        #endif
+        PROFILE_START(t_adc);
+        adcModule(ctx->afiltOutp, ctx->afiltOutn, ctx->adcOut, ctx);
+        PROFILE_STOP(t_adc, profile, STAGE_ADC, ctx->analog_nsamples);
+        #ifdef DO_PRINT
+            printf("Applied ADC module\n");
+        #endif
+        #ifdef DECIM_UNFUSED
+            PROFILE_START(t_dfilt);
+            dfiltModule(ctx->adcOut, ctx->dfiltOut, ctx);
+            PROFILE_STOP(t_dfilt, profile, STAGE_DFILT, ctx->adc_nsamples);
+            #ifdef DO_PRINT
+                printf("Applied digital filters module\n");
+            #endif
+            PROFILE_START(t_decim);
+            decimModule(ctx->dfiltOut, ctx->out, ctx);
+            PROFILE_STOP(t_decim, profile, STAGE_DECIM, ctx->adc_nsamples);
+            #ifdef DO_PRINT
+                printf("Applied decimation module\n");
+            #endif
+        #else
+            PROFILE_START(t_dfilt_decim);
+            dfiltDecimModule(ctx->adcOut, ctx->out, ctx);
+            PROFILE_STOP(t_dfilt_decim, profile, STAGE_DFILT_DECIM, ctx->adc_nsamples);
+            #ifdef DO_PRINT
+                printf("Applied digital filters and decimation module\n");
+            #endif
+        #endif // DECIM_UNFUSED
+    #endif // CHUNKED
+
+    return 0;
+}
+
+int run_buffer(afe_ctx_t* ctx, int subject_idx, int buffer_idx, int** out_segment, int* out_nsamples) {
+
+    #ifdef ALLOC_COUNT
+        long nallocs = alloc_count();
+    #endif // ALLOC_COUNT
+    int run_res = run_buffer_chain(ctx, subject_idx, buffer_idx, out_segment, out_nsamples);
+    #ifdef ALLOC_COUNT
+        // Steady state: everything is allocated by afe_ctx_init or while running the first buffer
+        nallocs = alloc_count() - nallocs;
+        if (ctx->nbuffers_run > 0 && nallocs > 0) {
+            fprintf(stderr, "%ld heap allocations in buffer %d of subject %s after warm-up\n", nallocs, buffer_idx+1, subject_list[subject_idx]);
+            run_res = 1;
+        }
+    #endif // ALLOC_COUNT
+    ctx->nbuffers_run++;
+
+    return run_res;
+}
+
+int write_buffer_output(int* out, int out_nsamples, int subject_idx, int buffer_idx, afe_ctx_t* ctx) {
+
+    char output_filename[100];
+    snprintf(output_filename, sizeof(output_filename), "%s%s/behav_out/%s/buffer%d.txt", ctx->config.run_folder, ctx->config.run_category, subject_list[subject_idx], buffer_idx+1);
+    PROFILE_START(t_write);
+    int write_res = write_intarray_to_file(out, out_nsamples, output_filename);
+    PROFILE_STOP(t_write, profile_buffer(ctx->profile, subject_idx, buffer_idx), STAGE_WRITE, out_nsamples);
+    #ifdef DO_PRINT
+        printf("Wrote output to file %s\n", output_filename);
+    #endif
+
+    return write_res;
+}
+
+int run_subject(afe_ctx_t* ctx, int subject_idx) {
+
+    printf("Running for subject %s\n", subject_list[subject_idx]);
+
+    #ifdef CONTINUOUS
+        // One noise stream for the whole recording
+        afe_ctx_seed(ctx, subject_idx, RNG_BUFFER_ALL);
+    #endif // CONTINUOUS
+
+    int* out_segment;
+    int out_nsamples;
+    for (int i=0; i<N_BUFFERS; i++) {
+        if (run_buffer(ctx, subject_idx, i, &out_segment, &out_nsamples) != 0) {
+            return 1;
+        }
+        write_buffer_output(out_segment, out_nsamples, subject_idx, i, ctx);
+    }
+
+    return 0;
+}
+
+// Subjects not started yet, shared by all worker threads
+typedef struct {
+    pthread_mutex_t     lock;
+    const afe_config_t* config;
+    profile_t*          profile;        // PROFILE only
+    int*                subjects;
+    int                 nsubjects;
+    int                 next_subject;
+    int                 nerrors;
+} subject_queue_t;
+
+static void* subject_worker_thread(void* arg) {
+
+    subject_queue_t* queue = (subject_queue_t*) arg;
+
+    afe_ctx_t ctx;
+    int init_res = afe_ctx_init(&ctx, queue->config);
+    ctx.profile = queue->profile;
+
+    int queue_idx;
+    int run_res;
+    while (1) {
+        pthread_mutex_lock(&queue->lock);
+        if (init_res != 0) {
+            fprintf(stderr, "Error at worker memory allocation\n");
+            queue->nerrors++;
+        }
+        queue_idx = (init_res == 0) ? queue->next_subject++ : queue->nsubjects;
+        pthread_mutex_unlock(&queue->lock);
+        if (queue_idx >= queue->nsubjects) {
+            break;
+        }
+
+        run_res = run_subject(&ctx, queue->subjects[queue_idx]);
+        if (run_res != 0) {
+            fprintf(stderr, "Error at running subject %s\n", subject_list[queue->subjects[queue_idx]]);
+            pthread_mutex_lock(&queue->lock);
+            queue->nerrors++;
+            pthread_mutex_unlock(&queue->lock);
+        }
+    }
+
+    afe_ctx_free(&ctx);
+
+    return NULL;
+}
+
+// Starts nthreads threads running thread_func(args[t]) and waits for them, or runs it in the calling thread if nthreads is 1
+static int run_threads(int nthreads, void* (*thread_func)(void*), void** args) {
+
+    if (nthreads <= 1) {
+        thread_func(args[0]);
+        return 0;
+    }
+
+    pthread_t* threads = (pthread_t*) malloc(nthreads * sizeof(pthread_t));
+    if (threads == NULL) {
+        return 1;
+    }
+    int nstarted = 0;
+    for (int t=0; t<nthreads; t++) {
+        if (pthread_create(&threads[t], NULL, thread_func, args[t]) != 0) {
+            fprintf(stderr, "Could not start worker thread %d, continuing with %d\n", t+1, nstarted);
+            break;
+        }
+        nstarted++;
+    }
+    for (int t=0; t<nstarted; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    free(threads);
+
+    return (nstarted == 0) ? 1 : 0;
+}
+
+int run_subjects(int nthreads, int* subjects, int nsubjects, const afe_config_t* config) {
+
+    subject_queue_t queue;
+    pthread_mutex_init(&queue.lock, NULL);
+    queue.config = config;
+    queue.subjects = subjects;
+    queue.nsubjects = nsubjects;
+    queue.next_subject = 0;
+    queue.nerrors = 0;
+    queue.profile = NULL;
+
+    if (nthreads > nsubjects) {
+        nthreads = nsubjects;
+    }
+
+    #ifdef NOISE_BANK
+        // Generated once, before the workers map it
+        if (noise_bank_build(config) != 0) {
+            return 1;
+        }
+    #endif // NOISE_BANK
+
+    #ifdef PROFILE
+        profile_t profile;
+        if (profile_init(&profile, nthreads) == 0) {
+            queue.profile = &profile;
+        }
+        double start = profile_now();
+    #endif // PROFILE
+
+    // All threads share the same queue
+    void** args = (void**) malloc(nthreads * sizeof(void*));
+    int threads_res = 1;
+    if (args != NULL) {
+        for (int t=0; t<nthreads; t++) {
+            args[t] = &queue;
+        }
+        threads_res = run_threads(nthreads, subject_worker_thread, args);
+        free(args);
+    }
+
+    #ifdef PROFILE
+        if (queue.profile != NULL) {
+            profile.wall_seconds = profile_now() - start;
+            profile_report(&profile, config);
+        }
+        profile_free(&profile);
+    #endif // PROFILE
+
+    pthread_mutex_destroy(&queue.lock);
+
+    return (threads_res != 0 || queue.nerrors > 0) ? 1 : 0;
+}
+
+#ifndef CONTINUOUS
+// Tasks of one worker: global task indices first + k*stride, for k in [next, end)
+typedef struct {
+    pthread_mutex_t     lock;
+    int                 first;
+    int                 stride;
+    int                 next;
+    int                 end;
+} task_queue_t;
+
+// Shared state of the buffer-level scheduler
+typedef struct {
+    const afe_config_t* config;
+    profile_t*          profile;        // PROFILE only
+    int*                subjects;
+    int                 ntasks;         // nsubjects * N_BUFFERS, task t is buffer t % N_BUFFERS of subject t / N_BUFFERS
+    int                 nqueues;
+    task_queue_t*       queues;         // one per worker
+    int                 max_pending;    // a worker only starts a task less than max_pending after the next one to write
+    pthread_mutex_t     write_lock;     // protects everything below
+    pthread_cond_t      write_cond;     // signaled when outputs are written or a worker fails
+    int**               pending;        // finished outputs not written yet, per task
+    char*               done;           // 0 if not finished, 1 if finished, 2 if failed, per task
+    int                 next_write;     // next task to write, outputs are written in task order
+    int                 writing;        // 1 while a worker writes outputs (outside of the lock)
+    int**               spare_outputs;  // output vectors free to reuse
+    int                 nspare;
+    int                 nerrors;
+    int                 nfailed_workers;
+} scheduler_t;
+
+typedef struct {
+    scheduler_t*        scheduler;
+    int                 queue_idx;
+} buffer_worker_arg_t;
+
+// Takes the next task of a queue, -1 if empty
+static int pop_task(task_queue_t* queue) {
+
+    int task = -1;
+    pthread_mutex_lock(&queue->lock);
+    if (queue->next < queue->end) {
+        task = queue->first + queue->next * queue->stride;
+        queue->next++;
+    }
+    pthread_mutex_unlock(&queue->lock);
+
+    return task;
+}
+
+// Takes the next task of the worker's own queue, otherwise steals the oldest task of the most loaded queue, -1 if all empty
+static int take_task(scheduler_t* s, int queue_idx) {
+
+    int task = pop_task(&s->queues[queue_idx]);
+    while (task < 0) {
+        int victim = -1;
+        int victim_load = 0;
+        for (int q=0; q<s->nqueues; q++) {
+            pthread_mutex_lock(&s->queues[q].lock);
+            int load = s->queues[q].end - s->queues[q].next;
+            pthread_mutex_unlock(&s->queues[q].lock);
+            if (load > victim_load) {
+                victim = q;
+                victim_load = load;
+            }
+        }
+        if (victim < 0) {
+            break;
+        }
+        // The victim may have been emptied in the meantime, then look again
+        task = pop_task(&s->queues[victim]);
+    }
+
+    return task;
+}
+
+// Waits until the task is less than max_pending after the next one to write, so that at most max_pending outputs wait
+// No deadlock: the next task to write is always held by a running worker or next in a queue whose worker is not waiting,
+// unless a worker failed, then the cap is lifted
+static void wait_task(scheduler_t* s, int task) {
+
+    pthread_mutex_lock(&s->write_lock);
+    while (task >= s->next_write + s->max_pending && s->nfailed_workers == 0) {
+        pthread_cond_wait(&s->write_cond, &s->write_lock);
+    }
+    pthread_mutex_unlock(&s->write_lock);
+}
+
+// Hands the output of a finished task to the scheduler and writes all outputs that are next in order
+// The worker gets a new output vector in exchange
+// The outputs are written outside of the lock by one worker at a time, which also writes those finished in the meantime
+static void commit_task(scheduler_t* s, afe_ctx_t* ctx, int task, int run_res) {
+
+    pthread_mutex_lock(&s->write_lock);
+
+    if (run_res == 0) {
+        s->pending[task] = ctx->out;
+        ctx->out = (s->nspare > 0) ? s->spare_outputs[--s->nspare] : (int*)malloc(OUT_NSAMPLES * sizeof(int));
+        s->done[task] = 1;
+    } else {
+        s->done[task] = 2;
+    }
+
+    while (!s->writing && s->next_write < s->ntasks && s->done[s->next_write] != 0) {
+        // Claims the ready outputs, done and pending do not change for them until next_write moves past them
+        int first = s->next_write;
+        int end = first;
+        while (end < s->ntasks && s->done[end] != 0) {
+            end++;
+        }
+        s->writing = 1;
+        pthread_mutex_unlock(&s->write_lock);
+
+        int nerrors = 0;
+        for (int t=first; t<end; t++) {
+            int subject_idx = s->subjects[t / N_BUFFERS];
+            int buffer_idx = t % N_BUFFERS;
+            if (buffer_idx == 0) {
+                printf("Running for subject %s\n", subject_list[subject_idx]);
+            }
+            if (s->done[t] == 1) {
+                write_buffer_output(s->pending[t], OUT_NSAMPLES, subject_idx, buffer_idx, ctx);
+            } else {
+                fprintf(stderr, "Error at running buffer %d of subject %s\n", buffer_idx+1, subject_list[subject_idx]);
+                nerrors++;
+            }
+        }
+
+        pthread_mutex_lock(&s->write_lock);
+        for (int t=first; t<end; t++) {
+            if (s->done[t] == 1) {
+                s->spare_outputs[s->nspare++] = s->pending[t];
+                s->pending[t] = NULL;
+            }
+        }
+        s->nerrors += nerrors;
+        s->next_write = end;
+        s->writing = 0;
+        pthread_cond_broadcast(&s->write_cond);
+    }
+
+    pthread_mutex_unlock(&s->write_lock);
+}
+
+// Stops a worker: its tasks are left to the others, which no longer wait for the outputs to be written
+static void fail_worker(scheduler_t* s) {
+
+    pthread_mutex_lock(&s->write_lock);
+    s->nerrors++;
+    s->nfailed_workers++;
+    pthread_cond_broadcast(&s->write_cond);
+    pthread_mutex_unlock(&s->write_lock);
+}
+
+static void* buffer_worker_thread(void* arg) {
+
+    scheduler_t* s = ((buffer_worker_arg_t*) arg)->scheduler;
+    int queue_idx = ((buffer_worker_arg_t*) arg)->queue_idx;
+
+    afe_ctx_t ctx;
+    if (afe_ctx_init(&ctx, s->config) != 0) {
+        // The other workers steal the tasks of this one
+        fprintf(stderr, "Error at worker memory allocation\n");
+        afe_ctx_free(&ctx);
+        fail_worker(s);
+        return NULL;
+    }
+    ctx.profile = s->profile;
+
+    int task;
+    int run_res;
+    int* out_segment;
+    int out_nsamples;
+    while ((task = take_task(s, queue_idx)) >= 0) {
+        wait_task(s, task);
+        run_res = run_buffer(&ctx, s->subjects[task / N_BUFFERS], task % N_BUFFERS, &out_segment, &out_nsamples);
+        commit_task(s, &ctx, task, run_res);
+        if (ctx.out == NULL) {
+            fprintf(stderr, "Error at output memory allocation\n");
+            fail_worker(s);
+            break;
+        }
+    }
+
+    afe_ctx_free(&ctx);
+
+    return NULL;
+}
+
+// Buffer-level scheduler of run_buffers
+static int schedule_buffers(int nthreads, int* subjects, int nsubjects, const afe_config_t* config) {
+
+    #ifdef NOISE_BANK
+        // Generated once, before the workers map it
+        if (noise_bank_build(config) != 0) {
+            return 1;
+        }
+    #endif // NOISE_BANK
+
+    scheduler_t s;
+    s.config = config;
+    s.subjects = subjects;
+    s.ntasks = nsubjects * N_BUFFERS;
+    s.nqueues = (nthreads < s.ntasks) ? nthreads : s.ntasks;
+    s.queues = (task_queue_t*) malloc(s.nqueues * sizeof(task_queue_t));
+    s.max_pending = MAX_PENDING_PER_THREAD * s.nqueues;
+    s.pending = (int**) calloc(s.ntasks, sizeof(int*));
+    s.done = (char*) calloc(s.ntasks, sizeof(char));
+    s.spare_outputs = (int**) malloc(s.ntasks * sizeof(int*));
+    s.nspare = 0;
+    s.next_write = 0;
+    s.writing = 0;
+    s.nerrors = 0;
+    s.nfailed_workers = 0;
+    s.profile = NULL;
+    pthread_mutex_init(&s.write_lock, NULL);
+    pthread_cond_init(&s.write_cond, NULL);
+
+    #ifdef PROFILE
+        profile_t profile;
+        if (profile_init(&profile, s.nqueues) == 0) {
+            s.profile = &profile;
+        }
+    #endif // PROFILE
+
+    buffer_worker_arg_t* worker_args = (buffer_worker_arg_t*) malloc(s.nqueues * sizeof(buffer_worker_arg_t));
+    void** args = (void**) malloc(s.nqueues * sizeof(void*));
+
+    int threads_res = 1;
+    if (s.queues != NULL && s.pending != NULL && s.done != NULL && s.spare_outputs != NULL && worker_args != NULL && args != NULL) {
+
+        // Tasks are dealt round-robin, so that workers progress through the recordings together and outputs are written early
+        for (int q=0; q<s.nqueues; q++) {
+            pthread_mutex_init(&s.queues[q].lock, NULL);
+            s.queues[q].first = q;
+            s.queues[q].stride = s.nqueues;
+            s.queues[q].next = 0;
+            s.queues[q].end = (s.ntasks - q + s.nqueues - 1) / s.nqueues;
+            worker_args[q].scheduler = &s;
+            worker_args[q].queue_idx = q;
+            args[q] = &worker_args[q];
+        }
+
+        #ifdef PROFILE
+            double start = profile_now();
+        #endif // PROFILE
+        threads_res = run_threads(s.nqueues, buffer_worker_thread, args);
+        #ifdef PROFILE
+            if (s.profile != NULL) {
+                profile.wall_seconds = profile_now() - start;
+                profile_report(&profile, config);
+            }
+        #endif // PROFILE
+
+        for (int q=0; q<s.nqueues; q++) {
+            pthread_mutex_destroy(&s.queues[q].lock);
+        }
+        // Tasks left (e.g. if workers failed) are reported as errors
+        if (s.next_write < s.ntasks) {
+            s.nerrors++;
+        }
+        for (int t=0; t<s.ntasks; t++) {
+            free(s.pending[t]);
+        }
+        for (int n=0; n<s.nspare; n++) {
+            free(s.spare_outputs[n]);
+        }
+    }
+
+    #ifdef PROFILE
+        profile_free(&profile);
+    #endif // PROFILE
+    pthread_mutex_destroy(&s.write_lock);
+    pthread_cond_destroy(&s.write_cond);
+    free(s.queues);
+    free(s.pending);
+    free(s.done);
+    free(s.spare_outputs);
+    free(worker_args);
+    free(args);
+
+    return (threads_res != 0 || s.nerrors > 0) ? 1 : 0;
+}
+#endif // CONTINUOUS
+
+int run_buffers(int nthreads, int* subjects, int nsubjects, const afe_config_t* config) {
+
+    #ifdef CONTINUOUS
+        // Buffers depend on the previous one
+        return run_subjects(nthreads, subjects, nsubjects, config);
+    #else
+        return schedule_buffers(nthreads, subjects, nsubjects, config);
+    #endif // CONTINUOUS
+}
+
+int run_sweep(int nthreads, int* subjects, int nsubjects, const afe_config_t* config, const char* sweep_filename) {
+
+    FILE* file = fopen(sweep_filename, "r");
+    if (file == NULL) {
+        fprintf(stderr, "Run sweep: Error opening file %s\n", sweep_filename);
+        return 1;
+    }
+
+    // One point per line: name=value overrides of the base configuration, separated by white spaces, text after # ignored
+    int npoints = 0;
+    int nerrors = 0;
+    char line[CONFIG_LINE_MAX];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        char* comment = strchr(line, '#');
+        if (comment != NULL) {
+            *comment = '\0';
+        }
+        line[strcspn(line, "\r\n")] = '\0';
+        if (strspn(line, " \t") == strlen(line)) {
+            continue;
+        }
+        npoints++;
+        printf("Sweep point %d: %s\n", npoints, line);
+
+        afe_config_t point = *config;
+        int point_res = 0;
+        for (char* token = strtok(line, " \t"); token != NULL; token = strtok(NULL, " \t")) {
+            if (afe_config_set(&point, token) != 0) {
+                point_res = 1;
+            }
+        }
+        if (point_res == 0) {
+            point_res = run_buffers(nthreads, subjects, nsubjects, &point);
+        }
+        if (point_res != 0) {
+            fprintf(stderr, "Error at sweep point %d\n", npoints);
+            nerrors++;
+        }
+    }
+
+    fclose(file);
+    return (nerrors > 0) ? 1 : 0;
+}
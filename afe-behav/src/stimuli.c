@@ -3,56 +3,197 @@
 #include <stddef.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 #include <math.h>
 
 #include "../include/setup.h"
 #include "../include/utils.h"
 #include "../include/stimuli.h"
+#include "../include/noise_bank.h"
 
-int stimuliModule(float* in1d, float* in2d, float* in1c, float* in2c, int buffer_idx, char* subject) {
+// Primes the history of a zeroed interpolator state with the first interp->delay inputs, which are then read ahead
+static void interp_prime(const double* signal_in, const interp_t* interp, interp_state_t* state) {
+
+    int nhist = interp->ntaps - 1;
+    for (int j=0; j<interp->delay; j++) {
+        state->hist[nhist - interp->delay + j] = (float)signal_in[j];
+    }
+}
+
+int stimuliModule(float* in1d, float* in2d, float* in1c, float* in2c, int buffer_idx, char* subject, afe_ctx_t* ctx) {
 
     // Define file names
-    int filename_max_size = 100;
-    char* filename1 = (char*)malloc(filename_max_size * sizeof(char));
-    snprintf(filename1, filename_max_size, "%s%s/buffer1_%d.bin", VENG_DATA_FOLDER, subject, buffer_idx+1);
-    char* filename2 = (char*)malloc(filename_max_size * sizeof(char));
-    snprintf(filename2, filename_max_size, "%s%s/buffer2_%d.bin", VENG_DATA_FOLDER, subject, buffer_idx+1);
+    char filename1[100];
+    snprintf(filename1, sizeof(filename1), "%s%s/buffer1_%d.bin", ctx->config.data_folder, subject, buffer_idx+1);
+    char filename2[100];
+    snprintf(filename2, sizeof(filename2), "%s%s/buffer2_%d.bin", ctx->config.data_folder, subject, buffer_idx+1);
     
-    // Read files
+    // Read files, staged as double in the scratch memory of the context, interpolated from zeroed states
+    double* staging = (double*)scratch_alloc(&ctx->scratch, INPUT_NSAMPLES * sizeof(double));
+    if (staging == NULL) {
+        return 1;
+    }
+    interp_state_t in1_interp = {0};
+    interp_state_t in2_interp = {0};
     int file_read_ctrl = 0;
-    file_read_ctrl += read_input_ffile(filename1, in1d);
-    file_read_ctrl += read_input_ffile(filename2, in2d);
+    file_read_ctrl += read_input_ffile(filename1, in1d, staging, &ctx->interp, &in1_interp);
+    file_read_ctrl += read_input_ffile(filename2, in2d, staging, &ctx->interp, &in2_interp);
+    scratch_release(&ctx->scratch, staging);
     if (file_read_ctrl > 0) {
         return 1;
     }
 
     // Reverse polarity on channel 1
-    for (int i=0; i<N_SAMPLES; i++) {
+    #ifdef COLLAPSE_LINEAR
+        // Only the average of the two inputs is used after the PCB
+        for (int i=0; i<ctx->analog_nsamples; i++) {
+            in1d[i] = (in2d[i] - in1d[i]) / 2;
+        }
+    #else
+        for (int i=0; i<ctx->analog_nsamples; i++) {
+            in1d[i] = - in1d[i];
+        }
+    #endif // COLLAPSE_LINEAR
+
+    // CM signal is generated as 1/f noise
+    cm_noise_generator(in1c, in2c, ctx->analog_nsamples, ctx);
+
+    return 0;
+}
+
+int stimuliLoadBuffer(int buffer_idx, char* subject, int offset, int size, afe_ctx_t* ctx) {
+
+    stimuli_buffer_t* buffer = &ctx->stimuli_buffer;
+
+    // Define file names
+    char filename1[100];
+    snprintf(filename1, sizeof(filename1), "%s%s/buffer1_%d.bin", ctx->config.data_folder, subject, buffer_idx+1);
+    char filename2[100];
+    snprintf(filename2, sizeof(filename2), "%s%s/buffer2_%d.bin", ctx->config.data_folder, subject, buffer_idx+1);
+
+    // Read files, interp.delay inputs ahead (see interp_design): at the beginning of a buffer the first ones prime the
+    // interpolators, otherwise they were read with the previous segment; past the end of the file the last input is held
+    int delay = ctx->interp.delay;
+    int first = (offset == 0) ? 0 : offset / INPUT_FS_RATIO + delay;
+    int end = (offset + size) / INPUT_FS_RATIO + delay;
+    int nread = ((end < INPUT_NSAMPLES) ? end : INPUT_NSAMPLES) - first;
+    int file_read_ctrl = 0;
+    file_read_ctrl += read_input_dfile(filename1, buffer->in1, first, nread);
+    file_read_ctrl += read_input_dfile(filename2, buffer->in2, first, nread);
+    if (file_read_ctrl > 0) {
+        return 1;
+    }
+    for (int i=nread; i<end - first; i++) {
+        buffer->in1[i] = buffer->in1[nread - 1];
+        buffer->in2[i] = buffer->in2[nread - 1];
+    }
+
+    // Only the average of the two inputs is used after the PCB, averaged before oversampling (linear interpolation)
+    #ifdef COLLAPSE_LINEAR
+        for (int i=0; i<end - first; i++) {
+            buffer->in1[i] = (buffer->in2[i] - buffer->in1[i]) / 2;
+        }
+    #endif // COLLAPSE_LINEAR
+
+    // Oversampling starts from zeroed states at the beginning of a buffer, otherwise continues from the previous segment
+    buffer->first_input = 0;
+    if (offset == 0) {
+        buffer->in1_interp = (interp_state_t){0};
+        buffer->in2_interp = (interp_state_t){0};
+        interp_prime(buffer->in1, &ctx->interp, &buffer->in1_interp);
+        interp_prime(buffer->in2, &ctx->interp, &buffer->in2_interp);
+        buffer->first_input = delay;
+    }
+
+    // CM signal is generated as 1/f noise, at the analog rate
+    cm_noise_generator(buffer->in1c, buffer->in2c, size / ctx->config.analog_fs_ratio, ctx);
+
+    return 0;
+}
+
+int stimuliModuleChunk(int offset, int size, float* in1d, float* in2d, afe_ctx_t* ctx) {
+
+    stimuli_buffer_t* buffer = &ctx->stimuli_buffer;
+
+    int input_offset = buffer->first_input + offset / INPUT_FS_RATIO;
+    int input_size = size / INPUT_FS_RATIO;
+
+    // Average of the two inputs, already reversed and averaged by stimuliLoadBuffer
+    #ifdef COLLAPSE_LINEAR
+        oversample_input(buffer->in1 + input_offset, in1d, input_size, &ctx->interp, &buffer->in1_interp);
+        return 0;
+    #endif // COLLAPSE_LINEAR
+
+    oversample_input(buffer->in1 + input_offset, in1d, input_size, &ctx->interp, &buffer->in1_interp);
+    oversample_input(buffer->in2 + input_offset, in2d, input_size, &ctx->interp, &buffer->in2_interp);
+
+    // Reverse polarity on channel 1
+    for (int i=0; i<input_size * ctx->input_ratio; i++) {
         in1d[i] = - in1d[i];
     }
 
+    return 0;
+}
 
-    // CM signal is generated as 1/f noise
-    if (INPUT_CM > 0) {
+int cm_noise_generator(float* in1c, float* in2c, int size, afe_ctx_t* ctx) {
+
+    if (ctx->config.input_cm > 0) {
+        #ifdef NOISE_BANK
+            noise_bank_chunk(in1c, size, &ctx->noise_bank, RNG_STREAM_CM1);
+            #ifndef COLLAPSE_LINEAR
+                noise_bank_chunk(in2c, size, &ctx->noise_bank, RNG_STREAM_CM2);
+            #endif // COLLAPSE_LINEAR
+            return 0;
+        #endif // NOISE_BANK
+        #ifdef NOISE_SYNTH
+            noise_synth_chunk(in1c, size, &ctx->noise_synth[RNG_STREAM_CM1], &ctx->rng[RNG_STREAM_CM1]);
+            #ifndef COLLAPSE_LINEAR
+                noise_synth_chunk(in2c, size, &ctx->noise_synth[RNG_STREAM_CM2], &ctx->rng[RNG_STREAM_CM2]);
+            #endif // COLLAPSE_LINEAR
+            return 0;
+        #endif // NOISE_SYNTH
         float cm_band[2] = {INPUT_CM_FMIN, INPUT_CM_FMAX};
-        float cm_power = INPUT_CM * INPUT_CM;
-        mixed_noise_generator_nsamples(in1c, cm_power, INPUT_CM_FMAX, cm_band);
-        mixed_noise_generator_nsamples(in2c, cm_power, INPUT_CM_FMAX, cm_band);
+        #ifdef COLLAPSE_LINEAR
+            // The average of two independent streams of power P is one stream of power P/2
+            float cm_power_avg = ctx->config.input_cm * ctx->config.input_cm / 2;
+            mixed_noise_generator_chunk(in1c, size, ctx->analog_fs, cm_power_avg, INPUT_CM_FMAX, cm_band, &ctx->chain_state.cm_pink[0], &ctx->rng[RNG_STREAM_CM1]);
+            return 0;
+        #endif // COLLAPSE_LINEAR
+        float cm_power = ctx->config.input_cm * ctx->config.input_cm;
+        mixed_noise_generator_chunk(in1c, size, ctx->analog_fs, cm_power, INPUT_CM_FMAX, cm_band, &ctx->chain_state.cm_pink[0], &ctx->rng[RNG_STREAM_CM1]);
+        mixed_noise_generator_chunk(in2c, size, ctx->analog_fs, cm_power, INPUT_CM_FMAX, cm_band, &ctx->chain_state.cm_pink[1], &ctx->rng[RNG_STREAM_CM2]);
     } else {
-        for (int i=0; i<N_SAMPLES; i++) {
+        for (int i=0; i<size; i++) {
             in1c[i] = 0.0f;
             in2c[i] = 0.0f;
         }   
     }
 
+    return 0;
+}
+
+int read_input_ffile(char* filename, float* signal, double* staging, const interp_t* interp, interp_state_t* state) {
 
-    free(filename1);
-    free(filename2);
+    // Read as double
+    if (read_input_dfile(filename, staging, 0, INPUT_NSAMPLES) != 0) {
+        return 1;
+    }
+
+    // Convert to float and over-sample, interp->delay inputs ahead: the first ones prime the history, the last input is held
+    // past the end of the file (see interp_design)
+    int delay = interp->delay;
+    double tail[INTERP_NTAPS_MAX];
+    for (int j=0; j<delay; j++) {
+        tail[j] = staging[INPUT_NSAMPLES - 1];
+    }
+    interp_prime(staging, interp, state);
+    oversample_input(staging + delay, signal, INPUT_NSAMPLES - delay, interp, state);
+    oversample_input(tail, signal + (INPUT_NSAMPLES - delay) * interp->ratio, delay, interp, state);
 
     return 0;
 }
 
-int read_input_ffile(char* filename, float* signal) {
+int read_input_dfile(char* filename, double* signal, int offset, int size) {
 
     // Open file
     FILE* file = fopen(filename, "rb");
@@ -61,30 +202,145 @@ int read_input_ffile(char* filename, float* signal) {
         return 1;
     }
 
-    // Read as double
-    double* signal_double = malloc(INPUT_NSAMPLES * sizeof(double));
-    size_t num_elem = fread(signal_double, sizeof(double), N_SAMPLES, file);
-    if (num_elem != INPUT_NSAMPLES) {
-        fprintf(stderr, "Read input ffile: File length = %d but expecting %d\n", (int)num_elem, INPUT_NSAMPLES);
+    // Read as double, only the requested samples
+    if (offset > 0 && fseek(file, offset * sizeof(double), SEEK_SET) != 0) {
+        fprintf(stderr, "Read input dfile: Cannot reach sample %d in file %s\n", offset, filename);
+        fclose(file);
+        return 1;
+    }
+    size_t num_elem = fread(signal, sizeof(double), size, file);
+    if (num_elem != size) {
+        fprintf(stderr, "Read input dfile: Read %d samples from %d but expecting %d\n", (int)num_elem, offset, size);
         fclose(file);
         return 1;
     }
 
-    // Convert to float and over-sample
-    double signal_previous_value = 0.0;
-    double signal_current_value = 0.0;
-    double signal_dv;
-    for (int i=0; i<INPUT_NSAMPLES; i++) {
-        signal_previous_value = signal_current_value;
-        signal_current_value = signal_double[i];
-        signal_dv = (signal_current_value - signal_previous_value) / INPUT_FS_RATIO;
-        for (int k=0; k<INPUT_FS_RATIO; k++) {
-            signal[i*INPUT_FS_RATIO+k] = (float)(signal_previous_value + signal_dv * (k+1));
+    fclose(file);
+
+    return 0;
+}
+
+int interp_design(interp_t* interp, int ratio, int filter, int ntaps) {
+
+    if (filter != INTERP_LINEAR && filter != INTERP_SINC) {
+        fprintf(stderr, "Invalid input interpolation %d\n", filter);
+        return 1;
+    }
+    if (filter == INTERP_SINC && (ntaps < 2 || ntaps > INTERP_NTAPS_MAX || ntaps % 2 != 0)) {
+        fprintf(stderr, "Invalid number of interpolation taps %d, must be even from 2 to %d\n", ntaps, INTERP_NTAPS_MAX);
+        return 1;
+    }
+    #ifdef INTERP_DOUBLE
+        if (filter != INTERP_LINEAR) {
+            fprintf(stderr, "INTERP_DOUBLE only interpolates linearly\n");
+            return 1;
+        }
+    #endif // INTERP_DOUBLE
+
+    interp->ratio = ratio;
+    interp->ntaps = (filter == INTERP_LINEAR) ? 2 : ntaps;
+    ntaps = interp->ntaps;
+    interp->delay = ntaps / 2 - 1;
+
+    // Below FS, the samples are taken at the same instants as the samples of index multiple of INPUT_FS_RATIO/ratio at FS:
+    // phase k lies at mu = (k*step+1)/INPUT_FS_RATIO after the input before last, delayed by ntaps/2-1 inputs for the FIR
+    int step = INPUT_FS_RATIO / ratio;
+    for (int k=0; k<ratio; k++) {
+        double mu = (double)(k * step + 1) / INPUT_FS_RATIO;
+        if (filter == INTERP_LINEAR) {
+            interp->coefs[k] = (float)(1 - mu);
+            interp->coefs[ratio + k] = (float)mu;
+            continue;
+        }
+        // Sinc at the input Nyquist frequency, Blackman window over the ntaps inputs, unit DC gain in every phase
+        double h[INTERP_NTAPS_MAX];
+        double sum = 0.0;
+        for (int t=0; t<ntaps; t++) {
+            double d = t + 1 - ntaps / 2 - mu;
+            double u = d / (ntaps / 2);
+            double sinc = (d == 0) ? 1.0 : sin(PI * d) / (PI * d);
+            h[t] = sinc * (0.42 + 0.5 * cos(PI * u) + 0.08 * cos(TWO_PI * u));
+            sum += h[t];
+        }
+        for (int t=0; t<ntaps; t++) {
+            interp->coefs[t * ratio + k] = (float)(h[t] / sum);
         }
     }
 
-    fclose(file);
-    free(signal_double);
+    return 0;
+}
+
+// Output samples of one input sample, all phases at once: out[k] = sum of coefs[t*ratio+k] * x[t] (vectorized over k)
+static inline void interp_phases(const float* restrict x, float* restrict out, const float* restrict coefs, int ntaps, int ratio) {
+
+    float acc[INPUT_FS_RATIO];
+    for (int k=0; k<ratio; k++) {
+        acc[k] = coefs[k] * x[0];
+    }
+    for (int t=1; t<ntaps; t++) {
+        for (int k=0; k<ratio; k++) {
+            acc[k] += coefs[t * ratio + k] * x[t];
+        }
+    }
+    for (int k=0; k<ratio; k++) {
+        out[k] = acc[k];
+    }
+}
+
+int oversample_input(double* signal_in, float* signal_out, int size, const interp_t* interp, interp_state_t* state) {
+
+    int ratio = interp->ratio;
+
+    #ifdef INTERP_DOUBLE
+        // Below FS, the samples are taken at the same instants as the samples of index multiple of INPUT_FS_RATIO/ratio at FS
+        int step = INPUT_FS_RATIO / ratio;
+        double signal_previous_value = 0.0;
+        double signal_current_value = state->prev;
+        double signal_dv;
+        for (int i=0; i<size; i++) {
+            signal_previous_value = signal_current_value;
+            signal_current_value = signal_in[i];
+            signal_dv = (signal_current_value - signal_previous_value) / INPUT_FS_RATIO;
+            for (int k=0; k<ratio; k++) {
+                signal_out[i*ratio+k] = (float)(signal_previous_value + signal_dv * (k*step+1));
+            }
+        }
+        state->prev = signal_current_value;
+    #else
+        // Inputs converted to float in a tile, after the history of the previous inputs
+        int ntaps = interp->ntaps;
+        int nhist = ntaps - 1;
+        float tile[INTERP_NTAPS_MAX - 1 + INTERP_TILE_NSAMPLES];
+        memcpy(tile, state->hist, nhist * sizeof(float));
+        int n;
+        for (int offset=0; offset<size; offset+=n) {
+            n = (size - offset < INTERP_TILE_NSAMPLES) ? size - offset : INTERP_TILE_NSAMPLES;
+            for (int i=0; i<n; i++) {
+                tile[nhist + i] = (float)signal_in[offset + i];
+            }
+            // Constant ratios, so that the phase loops are unrolled (up to FS: one SIMD vector of phases per input)
+            float* out = signal_out + offset * ratio;
+            if (ratio == 8) {
+                for (int i=0; i<n; i++) {
+                    interp_phases(tile + i, out + i * 8, interp->coefs, ntaps, 8);
+                }
+            } else if (ratio == 4) {
+                for (int i=0; i<n; i++) {
+                    interp_phases(tile + i, out + i * 4, interp->coefs, ntaps, 4);
+                }
+            } else if (ratio == 2) {
+                for (int i=0; i<n; i++) {
+                    interp_phases(tile + i, out + i * 2, interp->coefs, ntaps, 2);
+                }
+            } else {
+                for (int i=0; i<n; i++) {
+                    interp_phases(tile + i, out + i * ratio, interp->coefs, ntaps, ratio);
+                }
+            }
+            memmove(tile, tile + n, nhist * sizeof(float));
+        }
+        memcpy(state->hist, tile, nhist * sizeof(float));
+    #endif // INTERP_DOUBLE
 
     return 0;
-}
\ No newline at end of file
+}
@@ -3,6 +3,7 @@
 #include <stddef.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 #include <math.h>
 
 #include "../include/setup.h"
@@ -10,53 +11,89 @@
 
 int iir_order_1(float* sig_in, float* sig_out, int size, float* alpha, float* beta){
 
-    float x0 = 0.0f, x1 = 0.0f;
-    float y0 = 0.0f, y1 = 0.0f;
+    iir1_state_t state = {0};
+    return iir_order_1_chunk(sig_in, sig_out, size, alpha, beta, &state);
+}
+
+int iir_order_2(float* sig_in, float* sig_out, int size, float* alpha, float* beta){
+
+    iir2_state_t state = {0};
+    return iir_order_2_chunk(sig_in, sig_out, size, alpha, beta, &state);
+}
+
+int iir_order_2_int(int* sig_in, int* sig_out, int size, float* alpha, float* beta){
+
+    iir2_state_t state = {0};
+    return iir_order_2_int_chunk(sig_in, sig_out, size, alpha, beta, &state);
+}
+
+// Serial reference of iir_order_2_int_chunk
+static void iir_order_2_int_serial(int* sig_in, int* sig_out, int size, float* alpha, float* beta, iir2_state_t* state){
+
+    float x0 = state->x1, x1 = state->x2, x2;
+    float y0 = state->y1, y1 = state->y2, y2;
 
     float a1 = alpha[1] / alpha[0];
+    float a2 = alpha[2] / alpha[0];
     float b0 = beta[0] / alpha[0];
     float b1 = beta[1] / alpha[0];
+    float b2 = beta[2] / alpha[0];
 
     for (int i=0; i < size; i++) {
+        x2 = x1;
         x1 = x0;
+        y2 = y1;
         y1 = y0;
-        x0 = sig_in[i];
-        y0 = b1 * x1 + b0 * x0 - a1 * y1;
-        sig_out[i] = y0; 
+        x0 = (float)sig_in[i];
+        y0 = b2 * x2 + b1 * x1 + b0 * x0 - a2 * y2 - a1 * y1;
+        sig_out[i] = (int)roundf(y0); 
     }
 
-    return 0;
+    state->x1 = x0;
+    state->x2 = x1;
+    state->y1 = y0;
+    state->y2 = y1;
 }
 
-int iir_order_2(float* sig_in, float* sig_out, int size, float* alpha, float* beta){
+// The float recursions are evaluated in the order in which they are written (no reassociation, even with -Ofast),
+// so that the scalar filters and every SIMD lane of the multi-stream filters round identically
+#ifdef __GNUC__
+#pragma GCC push_options
+#pragma GCC optimize ("no-associative-math")
+#endif // __GNUC__
+
+// SIMD lanes: GCC vector extensions, compiled to SSE or AVX registers depending on the target flags (see SIMD_FLAGS in Makefile)
+#ifdef __GNUC__
+typedef float v8sf_t __attribute__((vector_size(8 * sizeof(float))));
+typedef float v4sf_t __attribute__((vector_size(4 * sizeof(float))));
+#endif // __GNUC__
 
-    float x0 = 0.0f, x1 = 0.0f, x2 = 0.0f;
-    float y0 = 0.0f, y1 = 0.0f, y2 = 0.0f;
+// Scalar filter of one stream with samples stride floats apart
+static inline void iir_order_1_strided(float* sig_in, float* sig_out, int stride, int size, float* alpha, float* beta, iir1_state_t* state) {
+
+    float x0 = state->x1, x1;
+    float y0 = state->y1, y1;
 
     float a1 = alpha[1] / alpha[0];
-    float a2 = alpha[2] / alpha[0];
     float b0 = beta[0] / alpha[0];
     float b1 = beta[1] / alpha[0];
-    float b2 = beta[2] / alpha[0];
 
     for (int i=0; i < size; i++) {
-        x2 = x1;
         x1 = x0;
-        y2 = y1;
         y1 = y0;
-        x0 = sig_in[i];
-        y0 = b2 * x2 + b1 * x1 + b0 * x0 - a2 * y2 - a1 * y1;
-        sig_out[i] = y0; 
+        x0 = sig_in[i * stride];
+        y0 = (b1 * x1 + b0 * x0) - a1 * y1;
+        sig_out[i * stride] = y0;
     }
 
-    return 0;
+    state->x1 = x0;
+    state->y1 = y0;
 }
 
+static inline void iir_order_2_strided(float* sig_in, float* sig_out, int stride, int size, float* alpha, float* beta, iir2_state_t* state) {
 
-int iir_order_2_int(int* sig_in, int* sig_out, int size, float* alpha, float* beta){
-
-    float x0 = 0.0f, x1 = 0.0f, x2 = 0.0f;
-    float y0 = 0.0f, y1 = 0.0f, y2 = 0.0f;
+    float x0 = state->x1, x1 = state->x2, x2;
+    float y0 = state->y1, y1 = state->y2, y2;
 
     float a1 = alpha[1] / alpha[0];
     float a2 = alpha[2] / alpha[0];
@@ -69,99 +106,1077 @@ int iir_order_2_int(int* sig_in, int* sig_out, int size, float* alpha, float* be
         x1 = x0;
         y2 = y1;
         y1 = y0;
-        x0 = (float)sig_in[i];
-        y0 = b2 * x2 + b1 * x1 + b0 * x0 - a2 * y2 - a1 * y1;
-        sig_out[i] = (int)roundf(y0); 
+        x0 = sig_in[i * stride];
+        y0 = ((b0 * x0 - a1 * y1) + (b2 * x2 + b1 * x1)) - a2 * y2;
+        sig_out[i * stride] = y0;
     }
 
-    return 0;
+    state->x1 = x0;
+    state->x2 = x1;
+    state->y1 = y0;
+    state->y2 = y1;
 }
 
+#ifdef __GNUC__
 
-float white_noise_sample_generator(float scale) {
+// Normalized coefficients {a1, a2, b0, b1, b2} of one stream, computed one by one as in the scalar filters
+// (a vectorized division would use an approximate reciprocal with -Ofast)
+static __attribute__((noinline)) void iir_normalize(float* alpha, float* beta, int order, float* coefs) {
 
-    float u1 = ((float) rand() + 1.0f) / ((float) RAND_MAX + 2.0f);
-    float u2 = ((float) rand()) / ((float) RAND_MAX);
-    return scale * sqrtf(-2.0f * logf(u1)) * cosf(TWO_PI * u2);
+    coefs[0] = alpha[1] / alpha[0];
+    coefs[1] = (order > 1) ? alpha[2] / alpha[0] : 0.0f;
+    coefs[2] = beta[0] / alpha[0];
+    coefs[3] = beta[1] / alpha[0];
+    coefs[4] = (order > 1) ? beta[2] / alpha[0] : 0.0f;
+}
+
+// Filters 8 consecutive streams from stream first of an interleaved vector
+static void iir_order_1_lanes8(float* sig_in, float* sig_out, int nstreams, int first, int size, float* alpha, float* beta, iir1_state_t* states) {
+
+    v8sf_t x0, x1, y0, y1, a1, b0, b1;
+    float coefs[5];
+    for (int k=0; k < 8; k++) {
+        iir_normalize(alpha + 2 * (first + k), beta + 2 * (first + k), 1, coefs);
+        a1[k] = coefs[0];
+        b0[k] = coefs[2];
+        b1[k] = coefs[3];
+        x0[k] = states[first + k].x1;
+        y0[k] = states[first + k].y1;
+    }
 
+    for (int i=0; i < size; i++) {
+        x1 = x0;
+        y1 = y0;
+        memcpy(&x0, sig_in + i * nstreams + first, sizeof(x0));
+        y0 = (b1 * x1 + b0 * x0) - a1 * y1;
+        memcpy(sig_out + i * nstreams + first, &y0, sizeof(y0));
+    }
+
+    for (int k=0; k < 8; k++) {
+        states[first + k].x1 = x0[k];
+        states[first + k].y1 = y0[k];
+    }
 }
 
-int white_noise_generator(float* white_noise, int size, float power, float* power_band) {
+static void iir_order_1_lanes4(float* sig_in, float* sig_out, int nstreams, int first, int size, float* alpha, float* beta, iir1_state_t* states) {
+
+    v4sf_t x0, x1, y0, y1, a1, b0, b1;
+    float coefs[5];
+    for (int k=0; k < 4; k++) {
+        iir_normalize(alpha + 2 * (first + k), beta + 2 * (first + k), 1, coefs);
+        a1[k] = coefs[0];
+        b0[k] = coefs[2];
+        b1[k] = coefs[3];
+        x0[k] = states[first + k].x1;
+        y0[k] = states[first + k].y1;
+    }
 
-    // Box-Muller method
+    for (int i=0; i < size; i++) {
+        x1 = x0;
+        y1 = y0;
+        memcpy(&x0, sig_in + i * nstreams + first, sizeof(x0));
+        y0 = (b1 * x1 + b0 * x0) - a1 * y1;
+        memcpy(sig_out + i * nstreams + first, &y0, sizeof(y0));
+    }
 
-    float scale;
+    for (int k=0; k < 4; k++) {
+        states[first + k].x1 = x0[k];
+        states[first + k].y1 = y0[k];
+    }
+}
 
-    if (power_band != NULL) {
-        float band = power_band[1] - power_band[0];
-        scale = sqrtf(power * (((float) FS) * (0.5 - 1/size)) / band);
-    } else {
-        scale = sqrtf(power);
+static void iir_order_2_lanes8(float* sig_in, float* sig_out, int nstreams, int first, int size, float* alpha, float* beta, iir2_state_t* states) {
+
+    v8sf_t x0, x1, x2, y0, y1, y2, a1, a2, b0, b1, b2;
+    float coefs[5];
+    for (int k=0; k < 8; k++) {
+        iir_normalize(alpha + 3 * (first + k), beta + 3 * (first + k), 2, coefs);
+        a1[k] = coefs[0];
+        a2[k] = coefs[1];
+        b0[k] = coefs[2];
+        b1[k] = coefs[3];
+        b2[k] = coefs[4];
+        x0[k] = states[first + k].x1;
+        x1[k] = states[first + k].x2;
+        y0[k] = states[first + k].y1;
+        y1[k] = states[first + k].y2;
     }
 
-    float u1;
-    float u2;
-    float u1_mult = 1 / ((float) RAND_MAX + 2.0f);
-    float u2_mult = 1 / ((float) RAND_MAX);
     for (int i=0; i < size; i++) {
-        u1 = ((float) rand() + 1.0f) * u1_mult;
-        u2 = ((float) rand()) * u2_mult;
-        white_noise[i] = scale * sqrtf(-2.0f * logf(u1)) * cosf(TWO_PI * u2);
+        x2 = x1;
+        x1 = x0;
+        y2 = y1;
+        y1 = y0;
+        memcpy(&x0, sig_in + i * nstreams + first, sizeof(x0));
+        y0 = ((b0 * x0 - a1 * y1) + (b2 * x2 + b1 * x1)) - a2 * y2;
+        memcpy(sig_out + i * nstreams + first, &y0, sizeof(y0));
     }
 
-    return 0;
+    for (int k=0; k < 8; k++) {
+        states[first + k].x1 = x0[k];
+        states[first + k].x2 = x1[k];
+        states[first + k].y1 = y0[k];
+        states[first + k].y2 = y1[k];
+    }
+}
+
+static void iir_order_2_lanes4(float* sig_in, float* sig_out, int nstreams, int first, int size, float* alpha, float* beta, iir2_state_t* states) {
+
+    v4sf_t x0, x1, x2, y0, y1, y2, a1, a2, b0, b1, b2;
+    float coefs[5];
+    for (int k=0; k < 4; k++) {
+        iir_normalize(alpha + 3 * (first + k), beta + 3 * (first + k), 2, coefs);
+        a1[k] = coefs[0];
+        a2[k] = coefs[1];
+        b0[k] = coefs[2];
+        b1[k] = coefs[3];
+        b2[k] = coefs[4];
+        x0[k] = states[first + k].x1;
+        x1[k] = states[first + k].x2;
+        y0[k] = states[first + k].y1;
+        y1[k] = states[first + k].y2;
+    }
 
+    for (int i=0; i < size; i++) {
+        x2 = x1;
+        x1 = x0;
+        y2 = y1;
+        y1 = y0;
+        memcpy(&x0, sig_in + i * nstreams + first, sizeof(x0));
+        y0 = ((b0 * x0 - a1 * y1) + (b2 * x2 + b1 * x1)) - a2 * y2;
+        memcpy(sig_out + i * nstreams + first, &y0, sizeof(y0));
+    }
+
+    for (int k=0; k < 4; k++) {
+        states[first + k].x1 = x0[k];
+        states[first + k].x2 = x1[k];
+        states[first + k].y1 = y0[k];
+        states[first + k].y2 = y1[k];
+    }
 }
 
-int pink_noise_generator(float* pink_noise, int size, float power, float* power_band) {
+#endif // __GNUC__
 
-    // Voss - McCartney algorithm
+int iir_order_1_streams(float* sig_in, float* sig_out, int nstreams, int size, float* alpha, float* beta, iir1_state_t* states) {
 
-    // Generate white noise from all sources
-    float white_noise_power;
-    float white_noise_power_sqrt;
-    if (power_band != NULL) {
-        float fratio = power_band[1] / power_band[0];
-        white_noise_power = power * logf(size / 2.0f) / logf(fratio) * PINK_NOISE_NSOURCES;
-    } else {
-        white_noise_power = power * PINK_NOISE_NSOURCES;
+    int first = 0;
+    #ifdef __GNUC__
+        for (; first + 8 <= nstreams; first += 8) {
+            iir_order_1_lanes8(sig_in, sig_out, nstreams, first, size, alpha, beta, states);
+        }
+        for (; first + 4 <= nstreams; first += 4) {
+            iir_order_1_lanes4(sig_in, sig_out, nstreams, first, size, alpha, beta, states);
+        }
+    #endif // __GNUC__
+    for (; first < nstreams; first++) {
+        iir_order_1_strided(sig_in + first, sig_out + first, nstreams, size, alpha + 2 * first, beta + 2 * first, &states[first]);
     }
-    white_noise_power_sqrt = sqrtf(white_noise_power);
-    float white_noise[PINK_NOISE_NSOURCES];
-    white_noise_generator(white_noise, PINK_NOISE_NSOURCES, white_noise_power, NULL);
-    float running_sum = sumf(white_noise, PINK_NOISE_NSOURCES);
 
-    // Algorithm
-    int key = 0;
-    int prev_key;
-    int diff_key;
-    int max_key = (1U << PINK_NOISE_NSOURCES) - 1;
-    float new_val;
+    return 0;
+}
+
+int iir_order_2_streams(float* sig_in, float* sig_out, int nstreams, int size, float* alpha, float* beta, iir2_state_t* states) {
+
+    int first = 0;
+    #ifdef __GNUC__
+        for (; first + 8 <= nstreams; first += 8) {
+            iir_order_2_lanes8(sig_in, sig_out, nstreams, first, size, alpha, beta, states);
+        }
+        for (; first + 4 <= nstreams; first += 4) {
+            iir_order_2_lanes4(sig_in, sig_out, nstreams, first, size, alpha, beta, states);
+        }
+    #endif // __GNUC__
+    for (; first < nstreams; first++) {
+        iir_order_2_strided(sig_in + first, sig_out + first, nstreams, size, alpha + 3 * first, beta + 3 * first, &states[first]);
+    }
+
+    return 0;
+}
+
+int iir_order_1_chunk(float* sig_in, float* sig_out, int size, float* alpha, float* beta, iir1_state_t* state){
+
+    #ifdef IIR_BLOCK
+        return iir_order_1_block(sig_in, sig_out, size, alpha, beta, state);
+    #endif // IIR_BLOCK
+
+    iir_order_1_strided(sig_in, sig_out, 1, size, alpha, beta, state);
+    return 0;
+}
+
+int iir_order_2_chunk(float* sig_in, float* sig_out, int size, float* alpha, float* beta, iir2_state_t* state){
+
+    #ifdef IIR_BLOCK
+        return iir_order_2_block(sig_in, sig_out, size, alpha, beta, state);
+    #endif // IIR_BLOCK
+
+    iir_order_2_strided(sig_in, sig_out, 1, size, alpha, beta, state);
+    return 0;
+}
+
+int iir_order_2_int_chunk(int* sig_in, int* sig_out, int size, float* alpha, float* beta, iir2_state_t* state){
+
+    #ifdef IIR_BLOCK
+        return iir_order_2_int_block(sig_in, sig_out, size, alpha, beta, state);
+    #endif // IIR_BLOCK
+
+    iir_order_2_int_serial(sig_in, sig_out, size, alpha, beta, state);
+    return 0;
+}
+
+int iir_order_2_delta_chunk(float* sig_in, float* sig_out, int size, float* delta, iir2_delta_state_t* state){
+
+    float n0 = delta[0], n1 = delta[1], n2 = delta[2], d1 = delta[3], d2 = delta[4];
+    float s1 = state->s1;
+    float s2 = state->s2;
+
     for (int i=0; i < size; i++) {
-        prev_key = key;
-        key++;
-        if (key > max_key) {
-            key = 0;
-        }
-        diff_key = prev_key ^ key;
-
-        for (int j=0; j < PINK_NOISE_NSOURCES; j++) {
-            if (diff_key & (1U << j)) {
-                new_val = white_noise_sample_generator(white_noise_power_sqrt);
-                running_sum += new_val - white_noise[j];
-                white_noise[j] = new_val;
+        float x = sig_in[i];
+        float y = n0 * x + s1;
+        s1 = s1 + (n1 * x - d1 * y + s2);
+        s2 = s2 + (n2 * x - d2 * y);
+        sig_out[i] = y;
+    }
+
+    state->s1 = s1;
+    state->s2 = s2;
+    return 0;
+}
+
+#ifdef __GNUC__
+#pragma GCC pop_options
+#endif // __GNUC__
+
+// Block state-space (look-ahead) filters: the output of a block of IIR_BLOCK_NSAMPLES samples is computed at once as
+//     y[0..7] = G * x[0..7] + F * state
+// G holds the zero-state responses to each input sample of the block (impulse response, Toeplitz) and
+// F the zero-input responses to each state component (rows of C * A^j)
+// The serial dependency is one block deep instead of one sample, the rest are independent SIMD multiply-adds
+// G, F and the state are kept in double: with poles close to 1 (e.g. the 7 Hz AFILT HPF at 640 kS/s), float block
+// coefficients lose the exact zero at DC, whereas in double the only error left is the rounding of the outputs
+#ifdef __GNUC__
+
+typedef double v8df_t __attribute__((vector_size(8 * sizeof(double))));
+
+typedef struct {
+    v8df_t  g[IIR_BLOCK_NSAMPLES];  // column m: response of the block to x[m] = 1
+    v8df_t  f[4];                   // response of the block to x[-1], x[-2], y[-1], y[-2] = 1 (only the first 2 for 1st order)
+} iir_block_t;
+
+// Response of a block to the inputs and initial conditions in x and y (x[j+2] = x[j], from x[-2]), written to out
+static void iir_block_response(double* c, int order, double* x, double* y, v8df_t* out) {
+
+    double a1 = c[0], a2 = c[1];
+    double b0 = c[2], b1 = c[3], b2 = c[4];
+    for (int j=0; j < IIR_BLOCK_NSAMPLES; j++) {
+        y[j + 2] = b0 * x[j + 2] + b1 * x[j + 1] - a1 * y[j + 1];
+        if (order > 1) {
+            y[j + 2] += b2 * x[j] - a2 * y[j];
+        }
+        (*out)[j] = y[j + 2];
+    }
+}
+
+// Builds G and F of a filter of order 1 or 2 from its normalized coefficients {a1, a2, b0, b1, b2}
+static void iir_block_init(iir_block_t* block, int order, float* coefs) {
+
+    double c[5] = {coefs[0], coefs[1], coefs[2], coefs[3], coefs[4]};
+
+    // Columns of G: input impulse at m = 0..7
+    for (int m=0; m < IIR_BLOCK_NSAMPLES; m++) {
+        double x[IIR_BLOCK_NSAMPLES + 2] = {0};
+        double y[IIR_BLOCK_NSAMPLES + 2] = {0};
+        x[m + 2] = 1.0;
+        iir_block_response(c, order, x, y, &block->g[m]);
+    }
+
+    // F: unit state x[-1], x[-2], y[-1], y[-2] (x[-1], y[-1] in 1st order)
+    for (int s=0; s < 2 * order; s++) {
+        double x[IIR_BLOCK_NSAMPLES + 2] = {0};
+        double y[IIR_BLOCK_NSAMPLES + 2] = {0};
+        if (order == 1) {
+            (s == 0 ? x : y)[1] = 1.0;
+        } else {
+            (s < 2 ? x : y)[1 - (s % 2)] = 1.0;
+        }
+        iir_block_response(c, order, x, y, &block->f[s]);
+    }
+}
+
+// Filters nblocks blocks from the state {x[-1], x[-2], y[-1], y[-2]} (x[-2] and y[-2] unused in 1st order), u holds the inputs
+static inline void iir_block_run(iir_block_t* block, int order, float* u, float* y, int nblocks, float* state) {
+
+    double x1 = state[0], x2 = state[1], y1 = state[2], y2 = state[3];
+    v8df_t v;
+    for (int b=0; b < nblocks; b++, u += IIR_BLOCK_NSAMPLES, y += IIR_BLOCK_NSAMPLES) {
+        // Known inputs first, off the critical path
+        v = block->f[0] * x1;
+        for (int m=0; m < IIR_BLOCK_NSAMPLES; m++) {
+            v += block->g[m] * u[m];
+        }
+        if (order > 1) {
+            v += block->f[1] * x2 + block->f[3] * y2;
+            v += block->f[2] * y1;
+        } else {
+            v += block->f[1] * y1;
+        }
+        // Inputs read before the outputs are written, as the filters may run in place (u == y)
+        x1 = u[IIR_BLOCK_NSAMPLES - 1];
+        x2 = u[IIR_BLOCK_NSAMPLES - 2];
+        for (int j=0; j < IIR_BLOCK_NSAMPLES; j++) {
+            y[j] = (float) v[j];
+        }
+        y1 = v[IIR_BLOCK_NSAMPLES - 1];
+        y2 = v[IIR_BLOCK_NSAMPLES - 2];
+    }
+    state[0] = x1;
+    state[1] = x2;
+    state[2] = y1;
+    state[3] = y2;
+}
+
+#endif // __GNUC__
+
+int iir_order_1_block(float* sig_in, float* sig_out, int size, float* alpha, float* beta, iir1_state_t* state) {
+
+    int nblocks = 0;
+    #ifdef __GNUC__
+        float coefs[5];
+        iir_normalize(alpha, beta, 1, coefs);
+        iir_block_t block;
+        iir_block_init(&block, 1, coefs);
+
+        nblocks = size / IIR_BLOCK_NSAMPLES;
+        float block_state[4] = {state->x1, 0.0f, state->y1, 0.0f};
+        iir_block_run(&block, 1, sig_in, sig_out, nblocks, block_state);
+        state->x1 = block_state[0];
+        state->y1 = block_state[2];
+    #endif // __GNUC__
+
+    // Last samples one by one
+    int done = nblocks * IIR_BLOCK_NSAMPLES;
+    iir_order_1_strided(sig_in + done, sig_out + done, 1, size - done, alpha, beta, state);
+
+    return 0;
+}
+
+int iir_order_2_block(float* sig_in, float* sig_out, int size, float* alpha, float* beta, iir2_state_t* state) {
+
+    int nblocks = 0;
+    #ifdef __GNUC__
+        float coefs[5];
+        iir_normalize(alpha, beta, 2, coefs);
+        iir_block_t block;
+        iir_block_init(&block, 2, coefs);
+
+        nblocks = size / IIR_BLOCK_NSAMPLES;
+        float block_state[4] = {state->x1, state->x2, state->y1, state->y2};
+        iir_block_run(&block, 2, sig_in, sig_out, nblocks, block_state);
+        *state = (iir2_state_t){block_state[0], block_state[1], block_state[2], block_state[3]};
+    #endif // __GNUC__
+
+    int done = nblocks * IIR_BLOCK_NSAMPLES;
+    iir_order_2_strided(sig_in + done, sig_out + done, 1, size - done, alpha, beta, state);
+
+    return 0;
+}
+
+int iir_order_2_int_block(int* sig_in, int* sig_out, int size, float* alpha, float* beta, iir2_state_t* state) {
+
+    int nblocks = 0;
+    #ifdef __GNUC__
+        float coefs[5];
+        iir_normalize(alpha, beta, 2, coefs);
+        iir_block_t block;
+        iir_block_init(&block, 2, coefs);
+
+        // Converted to float tile by tile, the state keeps the unrounded outputs as in the serial filter
+        float u[IIR_TILE_NFLOATS];
+        float y[IIR_TILE_NFLOATS];
+        float block_state[4] = {state->x1, state->x2, state->y1, state->y2};
+        nblocks = size / IIR_BLOCK_NSAMPLES;
+        int tile_nblocks = IIR_TILE_NFLOATS / IIR_BLOCK_NSAMPLES;
+        int n;
+        for (int b=0; b < nblocks; b += n) {
+            n = (nblocks - b < tile_nblocks) ? nblocks - b : tile_nblocks;
+            int* in = sig_in + b * IIR_BLOCK_NSAMPLES;
+            int* out = sig_out + b * IIR_BLOCK_NSAMPLES;
+            for (int i=0; i < n * IIR_BLOCK_NSAMPLES; i++) {
+                u[i] = (float)in[i];
+            }
+            iir_block_run(&block, 2, u, y, n, block_state);
+            for (int i=0; i < n * IIR_BLOCK_NSAMPLES; i++) {
+                out[i] = (int)roundf(y[i]);
+            }
+        }
+        *state = (iir2_state_t){block_state[0], block_state[1], block_state[2], block_state[3]};
+    #endif // __GNUC__
+
+    int done = nblocks * IIR_BLOCK_NSAMPLES;
+    iir_order_2_int_serial(sig_in + done, sig_out + done, size - done, alpha, beta, state);
+
+    return 0;
+}
+
+int iir_order_1_multi(float** sig_in, float** sig_out, int nstreams, int size, float* alpha, float* beta, iir1_state_t* states) {
+
+    float tile[IIR_TILE_NFLOATS];
+    int tile_nsamples = IIR_TILE_NFLOATS / nstreams;
+    int n;
+    float* in[nstreams];
+    float* out[nstreams];
+    for (int offset=0; offset < size; offset += n) {
+        n = (size - offset < tile_nsamples) ? size - offset : tile_nsamples;
+        for (int k=0; k < nstreams; k++) {
+            in[k] = sig_in[k] + offset;
+            out[k] = sig_out[k] + offset;
+        }
+        interleave_streams(in, tile, nstreams, n);
+        iir_order_1_streams(tile, tile, nstreams, n, alpha, beta, states);
+        deinterleave_streams(tile, out, nstreams, n);
+    }
+
+    return 0;
+}
+
+int iir_order_2_multi(float** sig_in, float** sig_out, int nstreams, int size, float* alpha, float* beta, iir2_state_t* states) {
+
+    float tile[IIR_TILE_NFLOATS];
+    int tile_nsamples = IIR_TILE_NFLOATS / nstreams;
+    int n;
+    float* in[nstreams];
+    float* out[nstreams];
+    for (int offset=0; offset < size; offset += n) {
+        n = (size - offset < tile_nsamples) ? size - offset : tile_nsamples;
+        for (int k=0; k < nstreams; k++) {
+            in[k] = sig_in[k] + offset;
+            out[k] = sig_out[k] + offset;
+        }
+        interleave_streams(in, tile, nstreams, n);
+        iir_order_2_streams(tile, tile, nstreams, n, alpha, beta, states);
+        deinterleave_streams(tile, out, nstreams, n);
+    }
+
+    return 0;
+}
+
+int interleave_streams(float** in, float* out, int nstreams, int size) {
+
+    for (int k=0; k < nstreams; k++) {
+        float* in_k = in[k];
+        for (int i=0; i < size; i++) {
+            out[i * nstreams + k] = in_k[i];
+        }
+    }
+
+    return 0;
+}
+
+int deinterleave_streams(float* in, float** out, int nstreams, int size) {
+
+    for (int k=0; k < nstreams; k++) {
+        float* out_k = out[k];
+        for (int i=0; i < size; i++) {
+            out_k[i] = in[i * nstreams + k];
+        }
+    }
+
+    return 0;
+}
+
+
+int iir_order_2_fixed_coefs(double* alpha, double* beta, int frac, int64_t* alpha_fixed, int64_t* beta_fixed) {
+
+    double scale = ldexp(1.0, frac) / alpha[0];
+    for (int k=0; k<3; k++) {
+        alpha_fixed[k] = llround(alpha[k] * scale);
+        beta_fixed[k] = llround(beta[k] * scale);
+    }
+
+    return 0;
+}
+
+int iir_order_2_fixed_chunk(int* sig_in, int* sig_out, int size, int64_t* alpha, int64_t* beta, iir2_fixed_state_t* state) {
+
+    int64_t a1 = alpha[1], a2 = alpha[2];
+    int64_t b0 = beta[0], b1 = beta[1], b2 = beta[2];
+    int64_t x1 = state->x1, x2 = state->x2;
+    int64_t y1 = state->y1, y2 = state->y2;
+
+    // The accumulator cannot overflow if it holds the largest sum of products (inputs and outputs within OUT_NBITS bits):
+    // its overflow is then skipped, which leaves the outputs unchanged and shortens the serial dependency
+    double acc_max = ldexp(fabs((double)b0) + fabs((double)b1) + fabs((double)b2) + fabs((double)a1) + fabs((double)a2), OUT_NBITS - 1 + DFILT_STATE_FRAC);
+    int acc_overflow = (acc_max >= ldexp(1.0, DFILT_ACC_BITS - 1));
+
+    int64_t ff[IIR_TILE_NFLOATS / 2]; // 4 kB, as the float tiles
+    int tile = IIR_TILE_NFLOATS / 2;
+    for (int start=0; start<size; start+=tile) {
+        int n = (size - start < tile) ? size - start : tile;
+        int* x = sig_in + start;
+
+        // Feed-forward products, independent from one sample to the next (exact integer sums)
+        ff[0] = b0 * x[0] + b1 * x1 + b2 * x2;
+        if (n > 1) {
+            ff[1] = b0 * x[1] + b1 * x[0] + b2 * x1;
+        }
+        for (int i=2; i<n; i++) {
+            ff[i] = b0 * x[i] + b1 * x[i-1] + b2 * x[i-2];
+        }
+        x2 = (n > 1) ? x[n-2] : x1;
+        x1 = x[n-1];
+
+        // Feedback, then one rounding and overflow per word
+        for (int i=0; i<n; i++) {
+            int64_t acc = ff[i] * ((int64_t)1 << DFILT_STATE_FRAC) - a1 * y1 - a2 * y2;
+            if (acc_overflow) {
+                acc = fixed_overflow(acc, DFILT_ACC_BITS, DFILT_SATURATION);
             }
+            int64_t y0 = fixed_overflow(fixed_shift(acc, DFILT_COEF_FRAC, DFILT_ROUNDING), OUT_NBITS + DFILT_STATE_FRAC, DFILT_SATURATION);
+            y2 = y1;
+            y1 = y0;
+            sig_out[start + i] = (int)fixed_overflow(fixed_shift(y0, DFILT_STATE_FRAC, DFILT_ROUNDING), OUT_NBITS, DFILT_SATURATION);
         }
+    }
+
+    state->x1 = x1;
+    state->x2 = x2;
+    state->y1 = y1;
+    state->y2 = y2;
+
+    return 0;
+}
 
-        pink_noise[i] = running_sum / PINK_NOISE_NSOURCES;
 
+int bilinear_order_1(double* b, double* a, double fs, float* alpha, float* beta) {
+
+    // s = K * (1 - z^-1) / (1 + z^-1), computed in double and normalized before rounding to float
+    double K = 2 * fs;
+    double a0 = a[0] * K + a[1];
+    alpha[0] = 1.0f;
+    alpha[1] = (float)((a[1] - a[0] * K) / a0);
+    beta[0] = (float)((b[0] * K + b[1]) / a0);
+    beta[1] = (float)((b[1] - b[0] * K) / a0);
+
+    return 0;
+}
+
+int bilinear_order_2(double* b, double* a, double fs, float* alpha, float* beta) {
+
+    double alpha_double[3], beta_double[3];
+    bilinear_order_2_double(b, a, fs, alpha_double, beta_double);
+    for (int k=0; k<3; k++) {
+        alpha[k] = (float)alpha_double[k];
+        beta[k] = (float)beta_double[k];
     }
 
     return 0;
 }
 
-int mixed_noise_generator_nsamples(float* noise, float total_power, float fcorner, float* power_band) {
+int bilinear_order_2_double(double* b, double* a, double fs, double* alpha, double* beta) {
+
+    double K = 2 * fs;
+    double K2 = K * K;
+    double a0 = a[0] * K2 + a[1] * K + a[2];
+    alpha[0] = 1.0;
+    alpha[1] = (2 * a[2] - 2 * a[0] * K2) / a0;
+    alpha[2] = (a[0] * K2 - a[1] * K + a[2]) / a0;
+    beta[0] = (b[0] * K2 + b[1] * K + b[2]) / a0;
+    beta[1] = (2 * b[2] - 2 * b[0] * K2) / a0;
+    beta[2] = (b[0] * K2 - b[1] * K + b[2]) / a0;
+
+    return 0;
+}
+
+int bilinear_order_2_delta(double* b, double* a, double fs, float* delta) {
+
+    // With r = z - 1, the sums of the z-domain coefficients reduce to the low-order terms of the prototype
+    double K = 2 * fs;
+    double K2 = K * K;
+    double a0 = a[0] * K2 + a[1] * K + a[2];
+    delta[0] = (float)((b[0] * K2 + b[1] * K + b[2]) / a0);
+    delta[1] = (float)((2 * b[1] * K + 4 * b[2]) / a0);
+    delta[2] = (float)(4 * b[2] / a0);
+    delta[3] = (float)((2 * a[1] * K + 4 * a[2]) / a0);
+    delta[4] = (float)(4 * a[2] / a0);
+
+    return 0;
+}
+
+
+int fft_init(float* tw_re, float* tw_im, int n) {
+
+    if (n < 4 || (n & (n - 1)) != 0) {
+        return 1;
+    }
+    tw_re[0] = 0.0f;
+    tw_im[0] = 0.0f;
+    for (int h=1; h < n; h <<= 1) {
+        for (int j=0; j < h; j++) {
+            tw_re[h + j] = (float)cos(PI * j / h);
+            tw_im[h + j] = (float)-sin(PI * j / h);
+        }
+    }
+
+    return 0;
+}
+
+int fft_forward(float* restrict re, float* restrict im, int n, const float* restrict tw_re, const float* restrict tw_im) {
+
+    // Butterflies, stage by stage (h: half size of the sub-transforms), twiddles applied after the difference
+    for (int h=n >> 1; h >= 4; h >>= 1) {
+        const float* wr = tw_re + h;
+        const float* wi = tw_im + h;
+        for (int b=0; b < n; b += 2 * h) {
+            float* ar = re + b;
+            float* ai = im + b;
+            float* br = re + b + h;
+            float* bi = im + b + h;
+            for (int j=0; j < h; j++) {
+                float dr = ar[j] - br[j];
+                float di = ai[j] - bi[j];
+                ar[j] = ar[j] + br[j];
+                ai[j] = ai[j] + bi[j];
+                br[j] = dr * wr[j] - di * wi[j];
+                bi[j] = dr * wi[j] + di * wr[j];
+            }
+        }
+    }
+
+    // Last two stages at once (twiddles 1 and -i)
+    for (int b=0; b < n; b += 4) {
+        float r0 = re[b] + re[b + 2], i0 = im[b] + im[b + 2];
+        float r2 = re[b] - re[b + 2], i2 = im[b] - im[b + 2];
+        float r1 = re[b + 1] + re[b + 3], i1 = im[b + 1] + im[b + 3];
+        float r3 = im[b + 1] - im[b + 3], i3 = re[b + 3] - re[b + 1];
+        re[b] = r0 + r1;
+        im[b] = i0 + i1;
+        re[b + 1] = r0 - r1;
+        im[b + 1] = i0 - i1;
+        re[b + 2] = r2 + r3;
+        im[b + 2] = i2 + i3;
+        re[b + 3] = r2 - r3;
+        im[b + 3] = i2 - i3;
+    }
+
+    return 0;
+}
+
+int fft_inverse(float* restrict re, float* restrict im, int n, const float* restrict tw_re, const float* restrict tw_im) {
+
+    // First two stages at once (twiddles 1 and +i)
+    for (int b=0; b < n; b += 4) {
+        float r0 = re[b] + re[b + 1], i0 = im[b] + im[b + 1];
+        float r1 = re[b] - re[b + 1], i1 = im[b] - im[b + 1];
+        float r2 = re[b + 2] + re[b + 3], i2 = im[b + 2] + im[b + 3];
+        float r3 = re[b + 2] - re[b + 3], i3 = im[b + 2] - im[b + 3];
+        re[b] = r0 + r2;
+        im[b] = i0 + i2;
+        re[b + 2] = r0 - r2;
+        im[b + 2] = i0 - i2;
+        re[b + 1] = r1 - i3;
+        im[b + 1] = i1 + r3;
+        re[b + 3] = r1 + i3;
+        im[b + 3] = i1 - r3;
+    }
 
+    // Butterflies, stage by stage (h: half size of the sub-transforms), conjugate twiddles applied before the sum
+    for (int h=4; h < n; h <<= 1) {
+        const float* wr = tw_re + h;
+        const float* wi = tw_im + h;
+        for (int b=0; b < n; b += 2 * h) {
+            float* ar = re + b;
+            float* ai = im + b;
+            float* br = re + b + h;
+            float* bi = im + b + h;
+            for (int j=0; j < h; j++) {
+                float tr = br[j] * wr[j] + bi[j] * wi[j];
+                float ti = bi[j] * wr[j] - br[j] * wi[j];
+                br[j] = ar[j] - tr;
+                bi[j] = ai[j] - ti;
+                ar[j] = ar[j] + tr;
+                ai[j] = ai[j] + ti;
+            }
+        }
+    }
+
+    return 0;
+}
+
+
+// sin(x) on [-pi/2, pi/2], odd minimax polynomial of degree 9 (approximation error 3.4e-9, below the float rounding)
+static inline float sat_sin(float x) {
+
+    float x2 = x * x;
+    return x * (0.99999997661f + x2 * (-0.16666647645f + x2 * (0.0083328999587f + x2 * (-0.00019800904698f + x2 * 2.5905004873e-6f))));
+}
+
+// 2^y for y in [0, 126]: exponent bits of 2^k times a minimax polynomial of 2^f on [-1/2, 1/2] (relative error 1.9e-9),
+// with k = y rounded and f = y - k
+static inline float sat_exp2(float y) {
+
+    int k = (int)(y + 0.5f);
+    float f = y - (float)k;
+    float p = 1.0000000006f + f * (0.69314720574f + f * (0.24022646890f + f * (0.055503287747f + f * (0.0096184889752f
+        + f * (0.0013399932103f + f * 0.00015345809158f)))));
+    int32_t bits = (int32_t)(k + 127) << 23;
+    float scale;
+    memcpy(&scale, &bits, sizeof(float));
+    return p * scale;
+}
+
+// tanh(x) = 1 - 2 / (exp(2|x|) + 1) with the sign of x, |x| bounded to 9 (tanh(9) = 1 - 3e-8 rounds to 1)
+static inline float sat_tanh(float x) {
+
+    float e = sat_exp2(fminf(fabsf(x), 9.0f) * 2.8853900818f); // 2 / ln(2)
+    return copysignf(1.0f - 2.0f / (e + 1.0f), x);
+}
+
+// Linear up to SAT_KNEE, then 1 - (2 - SAT_KNEE - |x|)^2 / (4 * (1 - SAT_KNEE)) up to 2 - SAT_KNEE (slopes 1 then 0), then 1
+static inline float sat_piecewise(float x) {
+
+    float a = fabsf(x);
+    float t = fminf(fmaxf(a - SAT_KNEE, 0.0f), 2 * (1 - SAT_KNEE));
+    return copysignf(fminf(a, SAT_KNEE) + t - t * t / (4 * (1 - SAT_KNEE)), x);
+}
+
+int saturate(float* x, int size, float vsat, int curve) {
+
+    float x_max = HALF_PI * vsat;
+    float inv_vsat = 1.0f / vsat;
+    switch (curve) {
+        case SAT_CURVE_SINE:
+            #ifdef SAT_LIBM
+                for (int i=0; i<size; i++) {
+                    if (x[i] > x_max) {
+                        x[i] = vsat;
+                    } else if (x[i] < -x_max) {
+                        x[i] = -vsat;
+                    } else {
+                        x[i] = vsat * sinf(x[i] / vsat);
+                    }
+                }
+            #else
+                for (int i=0; i<size; i++) {
+                    x[i] = vsat * sat_sin(fminf(fmaxf(x[i], -x_max), x_max) * inv_vsat);
+                }
+            #endif // SAT_LIBM
+            break;
+        case SAT_CURVE_TANH:
+            for (int i=0; i<size; i++) {
+                #ifdef SAT_LIBM
+                    x[i] = vsat * tanhf(x[i] / vsat);
+                #else
+                    x[i] = vsat * sat_tanh(x[i] * inv_vsat);
+                #endif // SAT_LIBM
+            }
+            break;
+        case SAT_CURVE_PIECEWISE:
+            for (int i=0; i<size; i++) {
+                x[i] = vsat * sat_piecewise(x[i] * inv_vsat);
+            }
+            break;
+        default:
+            return 1;
+    }
+
+    return 0;
+}
+
+
+// Philox4x32-10 constants: round multipliers and key increments (Weyl sequence)
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u
+#define PHILOX_W1 0xBB67AE85u
+
+// Encrypts the counter (block, stream) into 4 random words
+static void philox_block(const rng_t* rng, uint64_t block, uint32_t* out) {
+
+    uint32_t x0 = (uint32_t) block;
+    uint32_t x1 = (uint32_t) (block >> 32);
+    uint32_t x2 = rng->stream[0];
+    uint32_t x3 = rng->stream[1];
+    uint32_t k0 = rng->key[0];
+    uint32_t k1 = rng->key[1];
+    for (int r=0; r<10; r++) {
+        uint64_t p0 = (uint64_t) PHILOX_M0 * x0;
+        uint64_t p1 = (uint64_t) PHILOX_M1 * x2;
+        x0 = (uint32_t) (p1 >> 32) ^ x1 ^ k0;
+        x1 = (uint32_t) p1;
+        x2 = (uint32_t) (p0 >> 32) ^ x3 ^ k1;
+        x3 = (uint32_t) p0;
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+    out[0] = x0;
+    out[1] = x1;
+    out[2] = x2;
+    out[3] = x3;
+}
+
+#ifdef __GNUC__
+typedef uint32_t v8su_t __attribute__((vector_size(8 * sizeof(uint32_t))));
+typedef uint64_t v4du_t __attribute__((vector_size(4 * sizeof(uint64_t))));
+
+// High and low words of the products of the 8 lanes of x by m, as two widening multiplies of the even and odd lanes
+static inline void philox_mulhilo(const v8su_t* x, uint32_t m, v8su_t* hi, v8su_t* lo) {
+
+    const v4du_t mask = (v4du_t){0} + 0xFFFFFFFFULL;
+    v4du_t p_even = ((v4du_t) *x & mask) * m;
+    v4du_t p_odd = ((v4du_t) *x >> 32) * m;
+    *hi = (v8su_t) ((p_even >> 32) | (p_odd & ~mask));
+    *lo = (v8su_t) ((p_even & mask) | (p_odd << 32));
+}
+#endif // __GNUC__
+
+// Same as philox_block for the RNG_BATCH_NBLOCKS (8) blocks from first, one per SIMD lane, out in draw order
+static void philox_blocks(const rng_t* rng, uint64_t first, uint32_t* out) {
+
+    uint32_t k0 = rng->key[0];
+    uint32_t k1 = rng->key[1];
+    #ifdef __GNUC__
+        v8su_t x0, x1, x2, x3;
+        for (int l=0; l<RNG_BATCH_NBLOCKS; l++) {
+            x0[l] = (uint32_t) (first + l);
+            x1[l] = (uint32_t) ((first + l) >> 32);
+        }
+        x2 = (v8su_t){0} + rng->stream[0];
+        x3 = (v8su_t){0} + rng->stream[1];
+        for (int r=0; r<10; r++) {
+            v8su_t hi0, lo0, hi1, lo1;
+            philox_mulhilo(&x0, PHILOX_M0, &hi0, &lo0);
+            philox_mulhilo(&x2, PHILOX_M1, &hi1, &lo1);
+            x0 = hi1 ^ x1 ^ k0;
+            x1 = lo1;
+            x2 = hi0 ^ x3 ^ k1;
+            x3 = lo0;
+            k0 += PHILOX_W0;
+            k1 += PHILOX_W1;
+        }
+    #else
+        uint32_t x0[RNG_BATCH_NBLOCKS], x1[RNG_BATCH_NBLOCKS], x2[RNG_BATCH_NBLOCKS], x3[RNG_BATCH_NBLOCKS];
+        for (int l=0; l<RNG_BATCH_NBLOCKS; l++) {
+            x0[l] = (uint32_t) (first + l);
+            x1[l] = (uint32_t) ((first + l) >> 32);
+            x2[l] = rng->stream[0];
+            x3[l] = rng->stream[1];
+        }
+        for (int r=0; r<10; r++) {
+            for (int l=0; l<RNG_BATCH_NBLOCKS; l++) {
+                uint64_t p0 = (uint64_t) PHILOX_M0 * x0[l];
+                uint64_t p1 = (uint64_t) PHILOX_M1 * x2[l];
+                uint32_t y0 = (uint32_t) (p1 >> 32) ^ x1[l] ^ k0;
+                uint32_t y2 = (uint32_t) (p0 >> 32) ^ x3[l] ^ k1;
+                x0[l] = y0;
+                x1[l] = (uint32_t) p1;
+                x2[l] = y2;
+                x3[l] = (uint32_t) p0;
+            }
+            k0 += PHILOX_W0;
+            k1 += PHILOX_W1;
+        }
+    #endif // __GNUC__
+    for (int l=0; l<RNG_BATCH_NBLOCKS; l++) {
+        out[4*l] = x0[l];
+        out[4*l+1] = x1[l];
+        out[4*l+2] = x2[l];
+        out[4*l+3] = x3[l];
+    }
+}
+
+int rng_seed(rng_t* rng, uint64_t seed, uint32_t subject, uint32_t buffer, uint32_t source) {
+
+    // SplitMix64 spreads the seed over the key, the stream indices go to the counter as they are
+    uint64_t z = seed + 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z = z ^ (z >> 31);
+    rng->key[0] = (uint32_t) z;
+    rng->key[1] = (uint32_t) (z >> 32);
+    rng->stream[0] = buffer;
+    rng->stream[1] = (subject << 8) | (source & 0xFF);
+    rng->next = 0;
+    rng->block = UINT64_MAX;
+
+    return 0;
+}
+
+int rng_skip(rng_t* rng, uint64_t ndraws) {
+
+    rng->next += ndraws;
+
+    return 0;
+}
+
+int rng_block(const rng_t* rng, uint64_t block, uint32_t* out) {
+
+    philox_block(rng, block, out);
+
+    return 0;
+}
+
+uint32_t rng_uint32(rng_t* rng) {
+
+    uint64_t block = rng->next >> 2;
+    if (block != rng->block) {
+        philox_block(rng, block, rng->out);
+        rng->block = block;
+    }
+
+    return rng->out[rng->next++ & 3];
+}
+
+float rng_uniform(rng_t* rng) {
+
+    // 24 bits, exactly representable as float
+    return (float) (rng_uint32(rng) >> 8) * (1.0f / 16777216.0f);
+}
+
+int rng_uint32_batch(rng_t* rng, uint32_t* out, int size) {
+
+    // Up to the next block boundary, then RNG_BATCH_NBLOCKS blocks at a time, then the rest one by one
+    int i = 0;
+    for (; i<size && (rng->next & 3) != 0; i++) {
+        out[i] = rng_uint32(rng);
+    }
+    for (; i + 4 * RNG_BATCH_NBLOCKS <= size; i += 4 * RNG_BATCH_NBLOCKS) {
+        philox_blocks(rng, rng->next >> 2, out + i);
+        rng->next += 4 * RNG_BATCH_NBLOCKS;
+    }
+    for (; i<size; i++) {
+        out[i] = rng_uint32(rng);
+    }
+
+    return 0;
+}
+
+int rng_uniform_batch(rng_t* rng, float* out, int size) {
+
+    // Words drawn by stack tiles of 32 blocks, then converted as in rng_uniform
+    uint32_t bits[32 * 4];
+    int n;
+    for (int offset=0; offset<size; offset+=n) {
+        n = (size - offset < 32 * 4) ? size - offset : 32 * 4;
+        rng_uint32_batch(rng, bits, n);
+        for (int i=0; i<n; i++) {
+            out[offset + i] = (float) (bits[i] >> 8) * (1.0f / 16777216.0f);
+        }
+    }
+
+    return 0;
+}
+
+// ln(x) for x in (0, 1]: x = m * 2^e with m in [sqrt(1/2), sqrt(2)), ln(m) by the Cephes logf polynomial (1 ulp)
+static inline float gauss_log(float x) {
+
+    int32_t bits;
+    memcpy(&bits, &x, sizeof(float));
+    int32_t e = ((bits >> 23) & 0xFF) - 126;
+    bits = (bits & 0x007FFFFF) | 0x3F000000;
+    float m;
+    memcpy(&m, &bits, sizeof(float));
+    // m in [1/2, 1) here, doubled below sqrt(1/2)
+    int low = (m < 0.70710678f);
+    e -= low;
+    float t = (low ? m + m : m) - 1.0f;
+    float z = t * t;
+    float p = (((((((( 7.0376836292e-2f * t - 1.1514610310e-1f) * t + 1.1676998740e-1f) * t - 1.2420140846e-1f) * t
+        + 1.4249322787e-1f) * t - 1.6668057665e-1f) * t + 2.0000714765e-1f) * t - 2.4999993993e-1f) * t + 3.3333331174e-1f) * t * z;
+    float fe = (float) e;
+    // ln(2) split in two, so that fe * 0.693359375 is exact
+    return ((p - 2.12194440e-4f * fe) - 0.5f * z + t) + 0.693359375f * fe;
+}
+
+// sin and cos of 2*pi*u for u in [0, 1): quadrant q = 4u rounded, Cephes sinf and cosf polynomials of (4u - q) * pi/2
+static inline void gauss_sincos(float u, float* s, float* c) {
+
+    float v = 4.0f * u;
+    int q = (int) (v + 0.5f);
+    float x = (v - (float) q) * (float) HALF_PI;
+    float z = x * x;
+    float sx = ((-1.9515295891e-4f * z + 8.3321608736e-3f) * z - 1.6666654611e-1f) * z * x + x;
+    float cx = ((2.443315711809948e-5f * z - 1.388731625493765e-3f) * z + 4.166664568298827e-2f) * z * z - 0.5f * z + 1.0f;
+    // Rotation by q quarter turns
+    q &= 3;
+    float sq = (q & 1) ? cx : sx;
+    float cq = (q & 1) ? sx : cx;
+    *s = (q & 2) ? -sq : sq;
+    *c = ((q + 1) & 2) ? -cq : cq;
+}
+
+// Box-Muller transform of npairs pairs of uniforms (u1, u2) into the pairs of Gaussian samples (r cos, r sin)
+static inline void gauss_pairs(float* u, float* out, int npairs, float scale) {
+
+    for (int k=0; k < npairs; k++) {
+        float u1 = 1.0f - u[2*k];
+        float u2 = u[2*k+1];
+        float s, c;
+        #ifdef GAUSS_LIBM
+            float r = scale * sqrtf(-2.0f * logf(u1));
+            s = sinf(TWO_PI * u2);
+            c = cosf(TWO_PI * u2);
+        #else
+            float r = scale * sqrtf(-2.0f * gauss_log(u1));
+            gauss_sincos(u2, &s, &c);
+        #endif // GAUSS_LIBM
+        out[2*k] = r * c;
+        out[2*k+1] = r * s;
+    }
+}
+
+int gaussian_generator(float* out, int size, float scale, rng_t* rng) {
+
+    // Uniform pairs drawn by stack tiles, both outputs of the transform kept
+    float u[NOISE_TILE_NSAMPLES];
+    int n;
+    for (int offset=0; offset < size; offset+=n) {
+        n = (size - offset < NOISE_TILE_NSAMPLES) ? size - offset : NOISE_TILE_NSAMPLES;
+        int npairs = n / 2;
+        rng_uniform_batch(rng, u, 2 * npairs + 2 * (n & 1));
+        gauss_pairs(u, out + offset, npairs, scale);
+        if (n & 1) {
+            // Last sample of an odd size: the sine output of its pair is dropped
+            float last[2];
+            gauss_pairs(u + 2 * npairs, last, 1, scale);
+            out[offset + n - 1] = last[0];
+        }
+    }
+
+    return 0;
+}
+
+float white_noise_sample_generator(float scale, rng_t* rng) {
+
+    float out;
+    gaussian_generator(&out, 1, scale, rng);
+    return out;
+
+}
+
+// Standard deviation of the samples of white noise of the given power, drawn by vectors of size samples at fs
+static float white_noise_scale(int size, int fs, float power, float* power_band) {
+
+    if (power_band != NULL) {
+        float band = power_band[1] - power_band[0];
+        return sqrtf(power * (((float) fs) * (0.5 - 1/size)) / band);
+    }
+    return sqrtf(power * ((float) fs / FS)); // power defined at FS
+}
+
+// Power of each Voss-McCartney source for pink noise of the given power, defined for nsamples-long vectors
+static float pink_source_power(int nsamples, float power, float* power_band) {
+
+    if (power_band != NULL) {
+        float fratio = power_band[1] / power_band[0];
+        return power * logf(nsamples / 2.0f) / logf(fratio) * PINK_NOISE_NSOURCES;
+    }
+    return power * PINK_NOISE_NSOURCES;
+}
+
+// Split of the power of mixed noise between the white floor and the pink noise (same density at fcorner)
+static void mixed_noise_powers(float total_power, float fcorner, float* power_band, float* white_noise_power, float* pink_noise_power) {
+
+    // Powers are defined for N_SAMPLES-long buffers at FS, whatever the chunk size and sampling rate
+    // (same spectral densities at any fs, the Voss-McCartney sources keep the same power per octave)
     float pink_noise_factor;
     float white_noise_factor;
     if (power_band != NULL) {
@@ -172,16 +1187,250 @@ int mixed_noise_generator_nsamples(float* noise, float total_power, float fcorne
         white_noise_factor = ((float) FS) * (0.5 - 1/N_SAMPLES);
     }
     float white_psd = total_power / (white_noise_factor + pink_noise_factor);
-    float white_noise_power = white_psd * white_noise_factor;
-    float pink_noise_power = white_psd * pink_noise_factor;
+    *white_noise_power = white_psd * white_noise_factor;
+    *pink_noise_power = white_psd * pink_noise_factor;
+}
+
+int white_noise_generator(float* white_noise, int size, int fs, float power, float* power_band, rng_t* rng) {
 
-    float white_noise[N_SAMPLES];
-    float pink_noise[N_SAMPLES];
-    white_noise_generator(white_noise, N_SAMPLES, white_noise_power, power_band);
-    pink_noise_generator(pink_noise, N_SAMPLES, pink_noise_power, power_band);
+    return gaussian_generator(white_noise, size, white_noise_scale(size, fs, power, power_band), rng);
+
+}
+
+int pink_noise_generator(float* pink_noise, int size, float power, float* power_band, rng_t* rng) {
+
+    pink_state_t state;
+    pink_noise_init(&state, size, power, power_band, rng);
+    return pink_noise_generator_chunk(pink_noise, size, &state, rng);
+}
 
-    for (int i=0; i < N_SAMPLES; i++) {
-        noise[i] = white_noise[i] + pink_noise[i];
+int pink_noise_init(pink_state_t* state, int nsamples, float power, float* power_band, rng_t* rng) {
+
+    // Generate white noise from all sources
+    float white_noise_power = pink_source_power(nsamples, power, power_band);
+    state->source_scale = sqrtf(white_noise_power);
+    white_noise_generator(state->sources, PINK_NOISE_NSOURCES, FS, white_noise_power, NULL, rng);
+    state->running_sum = sumf(state->sources, PINK_NOISE_NSOURCES);
+    state->key = 0;
+
+    return 0;
+}
+
+int pink_noise_generator_chunk(float* pink_noise, int size, pink_state_t* state, rng_t* rng) {
+
+    // Voss - McCartney algorithm: source 0 (trickle) changes at every sample, source j >= 1 when the key has j-1 trailing
+    // zeros (every 2^j samples), so that exactly one source changes besides the trickle
+
+    float white_noise[PINK_NOISE_NSOURCES];
+    for (int j=0; j < PINK_NOISE_NSOURCES; j++) {
+        white_noise[j] = state->sources[j];
+    }
+    float running_sum = state->running_sum;
+
+    // Algorithm
+    int key = state->key;
+    int max_key = (1U << PINK_NOISE_NSOURCES) - 1;
+    // Two new values per sample, drawn in batch by stack tiles (the second is unused for the keys with more trailing zeros than sources)
+    float new_values[NOISE_TILE_NSAMPLES];
+    int n;
+    for (int offset=0; offset < size; offset+=n) {
+        n = (size - offset < NOISE_TILE_NSAMPLES / 2) ? size - offset : NOISE_TILE_NSAMPLES / 2;
+        gaussian_generator(new_values, 2 * n, state->source_scale, rng);
+
+        for (int i=0; i < n; i++) {
+            key = (key + 1) & max_key;
+            running_sum += new_values[2*i] - white_noise[0];
+            white_noise[0] = new_values[2*i];
+            #ifdef __GNUC__
+                int j = __builtin_ctz((unsigned) key | (1U << (PINK_NOISE_NSOURCES - 1))) + 1;
+            #else
+                int j = 1;
+                while (j < PINK_NOISE_NSOURCES && !(key & (1 << (j - 1)))) {
+                    j++;
+                }
+            #endif // __GNUC__
+            if (j < PINK_NOISE_NSOURCES) {
+                running_sum += new_values[2*i+1] - white_noise[j];
+                white_noise[j] = new_values[2*i+1];
+            }
+
+            pink_noise[offset + i] = running_sum / PINK_NOISE_NSOURCES;
+        }
+    }
+
+    for (int j=0; j < PINK_NOISE_NSOURCES; j++) {
+        state->sources[j] = white_noise[j];
+    }
+    state->running_sum = running_sum;
+    state->key = key;
+
+    return 0;
+}
+
+int mixed_noise_generator_nsamples(float* noise, float total_power, float fcorner, float* power_band, rng_t* rng) {
+
+    pink_state_t state = {0};
+    return mixed_noise_generator_chunk(noise, N_SAMPLES, FS, total_power, fcorner, power_band, &state, rng);
+}
+
+int mixed_noise_generator_chunk(float* noise, int size, int fs, float total_power, float fcorner, float* power_band, pink_state_t* state, rng_t* rng) {
+
+    float white_noise_power;
+    float pink_noise_power;
+    mixed_noise_powers(total_power, fcorner, power_band, &white_noise_power, &pink_noise_power);
+
+    white_noise_generator(noise, size, fs, white_noise_power, power_band, rng);
+    if (state->source_scale == 0.0f) {
+        pink_noise_init(state, N_SAMPLES, pink_noise_power, power_band, rng);
+    }
+    // Same draws as for the whole chunk at once: all white noise first, then the pink noise tile by tile
+    float pink_noise[NOISE_TILE_NSAMPLES];
+    int n;
+    for (int offset=0; offset < size; offset+=n) {
+        n = (size - offset < NOISE_TILE_NSAMPLES) ? size - offset : NOISE_TILE_NSAMPLES;
+        pink_noise_generator_chunk(pink_noise, n, state, rng);
+        for (int i=0; i < n; i++) {
+            noise[offset + i] = noise[offset + i] + pink_noise[i];
+        }
+    }
+
+    return 0;
+}
+
+int mixed_noise_scales(int fs, float total_power, float fcorner, float* power_band, float* white_scale, float* pink_scale) {
+
+    // Same powers as mixed_noise_generator_chunk, the pink noise state being initialized for N_SAMPLES
+    float white_noise_power;
+    float pink_noise_power;
+    mixed_noise_powers(total_power, fcorner, power_band, &white_noise_power, &pink_noise_power);
+    *white_scale = white_noise_scale(N_SAMPLES, fs, white_noise_power, power_band);
+    *pink_scale = sqrtf(pink_source_power(N_SAMPLES, pink_noise_power, power_band));
+
+    return 0;
+}
+
+
+int noise_synth_init(noise_synth_t* synth, int fs, float power, float fcorner, float* power_band) {
+
+    int nfft = NOISE_SYNTH_NFFT;
+    int nfade = NOISE_SYNTH_NFADE;
+    synth->re = (float*)malloc(nfft * sizeof(float));
+    synth->im = (float*)malloc(nfft * sizeof(float));
+    synth->amp = (float*)malloc(nfft * sizeof(float));
+    synth->tw_re = (float*)malloc(nfft * sizeof(float));
+    synth->tw_im = (float*)malloc(nfft * sizeof(float));
+    synth->fade = (float*)malloc(nfade * sizeof(float));
+    synth->tail = (float*)malloc(nfade * sizeof(float));
+    if (synth->re == NULL || synth->im == NULL || synth->amp == NULL || synth->tw_re == NULL || synth->tw_im == NULL
+        || synth->fade == NULL || synth->tail == NULL) {
+        return 1;
+    }
+    fft_init(synth->tw_re, synth->tw_im, nfft);
+
+    // PSD S(f) = w * (1 + fcorner / f), with w such that the bins in the band hold exactly the power
+    double df = (double) fs / nfft;
+    double fmin = (power_band != NULL) ? power_band[0] : 0.0;
+    double fmax = (power_band != NULL) ? power_band[1] : fs / 2.0;
+    double band_sum = 0.0;
+    for (int j=1; j < nfft / 2; j++) {
+        double f = j * df;
+        if (f >= fmin && f <= fmax) {
+            band_sum += (1.0 + fcorner / f) * df;
+        }
+    }
+    if (band_sum == 0.0) {
+        fprintf(stderr, "Noise synthesis: no bin in the band from %g to %g Hz\n", fmin, fmax);
+        return 1;
+    }
+    double w = power / band_sum;
+
+    // Bins k and -k each hold half the power of their frequency, none at DC and Nyquist
+    int log_nfft = 0;
+    while ((1 << log_nfft) < nfft) {
+        log_nfft++;
+    }
+    for (int p=0; p < nfft; p++) {
+        int k = 0;
+        for (int b=0; b < log_nfft; b++) {
+            k |= ((p >> b) & 1) << (log_nfft - 1 - b);
+        }
+        int j = (k <= nfft / 2) ? k : nfft - k;
+        synth->amp[p] = (j == 0 || j == nfft / 2) ? 0.0f : (float) sqrt(w * (1.0 + fcorner / (j * df)) * df / 2);
+    }
+
+    // Power-complementary gains: fade-in sin, fade-out cos
+    for (int i=0; i < nfade; i++) {
+        synth->fade[i] = (float) sin(HALF_PI * (i + 0.5) / nfade);
+    }
+    noise_synth_reset(synth);
+
+    return 0;
+}
+
+int noise_synth_free(noise_synth_t* synth) {
+
+    free(synth->re);
+    free(synth->im);
+    free(synth->amp);
+    free(synth->tw_re);
+    free(synth->tw_im);
+    free(synth->fade);
+    free(synth->tail);
+
+    return 0;
+}
+
+int noise_synth_reset(noise_synth_t* synth) {
+
+    synth->frame = -1;
+    synth->pos = 0;
+    synth->fading = 0;
+
+    return 0;
+}
+
+int noise_synth_chunk(float* noise, int size, noise_synth_t* synth, rng_t* rng) {
+
+    int nfft = NOISE_SYNTH_NFFT;
+    int nfade = NOISE_SYNTH_NFADE;
+    int n;
+    for (int offset=0; offset < size; offset+=n) {
+
+        // Next frame once the current one reaches its crossfade, whose samples are kept in tail
+        if (synth->frame < 0 || synth->pos == nfft - nfade) {
+            synth->fading = (synth->frame >= 0);
+            if (synth->fading) {
+                memcpy(synth->tail, ((synth->frame == 0) ? synth->re : synth->im) + nfft - nfade, nfade * sizeof(float));
+            }
+            if (synth->frame == 0) {
+                synth->frame = 1;
+            } else {
+                // Both parts played: new spectrum of independent complex gaussian bins, shaped and brought back to time
+                gaussian_generator(synth->re, nfft, 1.0f, rng);
+                gaussian_generator(synth->im, nfft, 1.0f, rng);
+                for (int p=0; p < nfft; p++) {
+                    synth->re[p] *= synth->amp[p];
+                    synth->im[p] *= synth->amp[p];
+                }
+                fft_inverse(synth->re, synth->im, nfft, synth->tw_re, synth->tw_im);
+                synth->frame = 0;
+            }
+            synth->pos = 0;
+        }
+
+        float* frame = (synth->frame == 0) ? synth->re : synth->im;
+        int pos = synth->pos;
+        n = (size - offset < nfft - nfade - pos) ? size - offset : nfft - nfade - pos;
+        int i = 0;
+        if (synth->fading) {
+            for (; i < n && pos + i < nfade; i++) {
+                noise[offset + i] = synth->tail[pos + i] * synth->fade[nfade - 1 - pos - i] + frame[pos + i] * synth->fade[pos + i];
+            }
+        }
+        for (; i < n; i++) {
+            noise[offset + i] = frame[pos + i];
+        }
+        synth->pos += n;
     }
 
     return 0;
@@ -327,3 +1576,81 @@ int write_multiintarray_to_file(int** array, uint32_t nArrays, uint32_t arraySiz
 }
 
 
+
+///////////////////////////////////////////
+//   Memory
+///////////////////////////////////////////
+
+int scratch_init(scratch_t* scratch, size_t size) {
+
+    *scratch = (scratch_t){0};
+    if (size == 0) {
+        return 0;
+    }
+    scratch->base = (char*)malloc(size);
+    if (scratch->base == NULL) {
+        return 1;
+    }
+    scratch->size = size;
+
+    return 0;
+}
+
+void* scratch_alloc(scratch_t* scratch, size_t size) {
+
+    // Slices start on SCRATCH_ALIGN boundaries of the address space, whatever the alignment of the base
+    size_t start = scratch->used;
+    if (scratch->base != NULL) {
+        start += -(uintptr_t)(scratch->base + scratch->used) & (SCRATCH_ALIGN - 1);
+    }
+    if (scratch->base == NULL || start + size > scratch->size) {
+        fprintf(stderr, "Scratch memory exhausted: %zu bytes requested, %zu used out of %zu\n", size, scratch->used, scratch->size);
+        return NULL;
+    }
+    scratch->used = start + size;
+
+    return scratch->base + start;
+}
+
+int scratch_release(scratch_t* scratch, void* slice) {
+
+    scratch->used = (size_t)((char*)slice - scratch->base);
+
+    return 0;
+}
+
+int scratch_free(scratch_t* scratch) {
+
+    free(scratch->base);
+    *scratch = (scratch_t){0};
+
+    return 0;
+}
+
+#ifdef ALLOC_COUNT
+// Per-thread count, so that the workers check their own buffers; the parentheses call the functions, not the macros
+static __thread long alloc_counter = 0;
+
+long alloc_count(void) {
+
+    return alloc_counter;
+}
+
+void* counted_malloc(size_t size) {
+
+    alloc_counter++;
+    return (malloc)(size);
+}
+
+void* counted_calloc(size_t nmemb, size_t size) {
+
+    alloc_counter++;
+    return (calloc)(nmemb, size);
+}
+
+void* counted_realloc(void* ptr, size_t size) {
+
+    alloc_counter++;
+    return (realloc)(ptr, size);
+}
+#endif // ALLOC_COUNT
@@ -0,0 +1,197 @@
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "../include/setup.h"
+#include "../include/utils.h"
+#include "../include/pcb.h"
+#include "../include/ia.h"
+#include "../include/afilt.h"
+#include "../include/lti.h"
+#include "../include/afe_ctx.h"
+
+// Test of the approximations of the linear path (make test): the differential AFILT output of pcb -> ia -> afilt, on a full
+// buffer and by chunks of uneven sizes, for the same deterministic stimuli without noise
+// The reference build writes its outputs to the file given as argument, the COLLAPSE_LINEAR and LTI_FFT builds compare theirs
+// to it (see the Makefile)
+//     COLLAPSE_LINEAR: the two inputs averaged before the PCB filters, equal to the reference within float rounding
+//     LTI_FFT: ltiModuleChunk then the AFILT HPF, within the error bound documented in ltiModuleChunk
+// All builds use IIR_DELTA: the direct-form AFILT biquads amplify the float rounding of the upstream stages to about 2 % of
+// the output, so that any change of the rounding (e.g. averaging before or after the PCB) would exceed the tolerances
+
+#define TEST_NCHUNK_SIZES 5 // Chunk sizes of the chunked runs, cycled until the end of the buffer
+
+#define COLLAPSE_RMS_TOL 5e-6 // Error RMS relative to the output RMS (float rounding of the filters, measured 1.5e-6)
+#define COLLAPSE_MAX_TOL 2e-5 // Largest error relative to the output RMS (measured 4.4e-6)
+#define LTI_RMS_TOL 3e-5 // Error RMS relative to the output RMS, bound of ltiModuleChunk (measured 1.4e-5)
+#define LTI_MAX_TOL 1e-4 // Largest error relative to the output RMS (measured 3.7e-5)
+
+#define TEST_DM_RMS 2e-6 // RMS of the white part of each differential input, in V
+#define TEST_CM_AMP 1e-3 // Amplitude of the common-mode inputs, in V
+
+static const int chunk_sizes[TEST_NCHUNK_SIZES] = {1, 37, 1000, 4099, 20000};
+
+static int nfailed = 0;
+
+static void check(const char* name, double value, int passed) {
+
+    printf("%-40s %12.6g  %s\n", name, value, passed ? "PASS" : "FAIL");
+    nfailed += !passed;
+}
+
+// Stimuli at the input of the PCB (after the polarity reversal of input 1): white noise of fixed seed and tones in the
+// differential inputs, tones in the common-mode inputs, small enough to keep the AFILT away from saturation
+static void stimuli_init(float* in1d, float* in2d, float* in1c, float* in2c, int size, int fs) {
+
+    rng_t rng;
+    rng_seed(&rng, SEED, 0, 0, 0);
+    gaussian_generator(in1d, size, TEST_DM_RMS, &rng);
+    gaussian_generator(in2d, size, TEST_DM_RMS, &rng);
+    for (int i=0; i<size; i++) {
+        double t = (double) i / fs;
+        in1d[i] += (float) (3e-6 * sin(TWO_PI * 1000.0 * t) + 1e-6 * sin(TWO_PI * 2500.0 * t + 0.3));
+        in2d[i] += (float) (2e-6 * sin(TWO_PI * 700.0 * t + 1.0) + 1e-6 * sin(TWO_PI * 150.0 * t));
+        in1c[i] = (float) (TEST_CM_AMP * sin(TWO_PI * 50.0 * t));
+        in2c[i] = (float) (TEST_CM_AMP * sin(TWO_PI * 50.0 * t + 0.1) + 0.5 * TEST_CM_AMP * sin(TWO_PI * 20e3 * t));
+    }
+    #ifdef COLLAPSE_LINEAR
+        // Only the averages of the two inputs go through the PCB (see stimuliModule)
+        for (int i=0; i<size; i++) {
+            in1d[i] = (in1d[i] + in2d[i]) / 2;
+            in1c[i] = (in1c[i] + in2c[i]) / 2;
+        }
+    #endif // COLLAPSE_LINEAR
+}
+
+// Differential AFILT output (every sample) of the stimuli, from zeroed states, on the whole buffer (chunked == 0) or by chunks
+// of chunk_sizes samples (as run_buffer in stream mode)
+static void run_chain(float* in1d, float* in2d, float* in1c, float* in2c, float* out, int chunked, afe_ctx_t* ctx) {
+
+    int size = ctx->analog_nsamples;
+    afe_ctx_reset(ctx);
+    if (!chunked) {
+        #ifdef LTI_FFT
+            ltiModule(in1d, in2d, in1c, in2c, ctx->iaOut, ctx);
+        #else
+            pcbModule(in1d, in2d, in1c, in2c, ctx->pcbOut1d, ctx->pcbOut2d, ctx->pcbOut1c, ctx->pcbOut2c, ctx);
+            iaModule(ctx->pcbOut1d, ctx->pcbOut2d, ctx->pcbOut1c, ctx->pcbOut2c, ctx->iaOut, ctx);
+        #endif // LTI_FFT
+        afiltModule(ctx->iaOut, ctx->afiltOutp, ctx->afiltOutn, 1, ctx);
+    } else {
+        #ifdef NOISY
+            ia_noise_generator(ctx->iaNoise, size, ctx);
+        #endif // NOISY
+        int n;
+        for (int offset=0, c=0; offset<size; offset+=n, c++) {
+            n = (chunk_sizes[c % TEST_NCHUNK_SIZES] < size - offset) ? chunk_sizes[c % TEST_NCHUNK_SIZES] : size - offset;
+            float* noise = (ctx->iaNoise != NULL) ? ctx->iaNoise + offset : NULL;
+            #ifdef LTI_FFT
+                ltiModuleChunk(in1d + offset, in2d + offset, in1c + offset, in2c + offset, noise, ctx->iaOut + offset, n, ctx);
+            #else
+                pcbModuleChunk(in1d + offset, in2d + offset, in1c + offset, in2c + offset, ctx->pcbOut1d + offset, ctx->pcbOut2d + offset,
+                    ctx->pcbOut1c + offset, ctx->pcbOut2c + offset, n, ctx);
+                iaModuleChunk(ctx->pcbOut1d + offset, ctx->pcbOut2d + offset, ctx->pcbOut1c + offset, ctx->pcbOut2c + offset, noise,
+                    ctx->iaOut + offset, n, ctx);
+            #endif // LTI_FFT
+            afiltModuleChunk(ctx->iaOut + offset, ctx->afiltOutp + offset, ctx->afiltOutn + offset, n, 1, ctx);
+        }
+    }
+    for (int i=0; i<size; i++) {
+        out[i] = ctx->afiltOutp[i] - ctx->afiltOutn[i];
+    }
+}
+
+#if defined(COLLAPSE_LINEAR) || defined(LTI_FFT)
+// Error of the output against the reference, relative to the RMS of the reference
+static void compare(const char* run, const float* out, const float* ref, int size, double rms_tol, double max_tol) {
+
+    double ref_power = 0.0, err_power = 0.0, err_max = 0.0;
+    for (int i=0; i<size; i++) {
+        double err = fabs((double) out[i] - ref[i]);
+        ref_power += (double) ref[i] * ref[i];
+        err_power += err * err;
+        err_max = (err > err_max) ? err : err_max;
+    }
+    double ref_rms = sqrt(ref_power / size);
+    char name[64];
+    snprintf(name, sizeof(name), "%s relative error RMS", run);
+    check(name, sqrt(err_power / size) / ref_rms, sqrt(err_power / size) < rms_tol * ref_rms);
+    snprintf(name, sizeof(name), "%s relative error max", run);
+    check(name, err_max / ref_rms, err_max < max_tol * ref_rms);
+}
+#endif // COLLAPSE_LINEAR, LTI_FFT
+
+int main(int argc, char* argv[]) {
+
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s reference_file\n", argv[0]);
+        return 1;
+    }
+
+    // Noise disabled, the stimuli are given to the PCB directly
+    afe_config_t config;
+    afe_config_default(&config);
+    config.input_cm = 0.0;
+    config.ia_noise = 0.0f;
+    afe_ctx_t ctx;
+    int size = N_SAMPLES / config.analog_fs_ratio;
+    float* in1d = (float*)malloc(size * sizeof(float));
+    float* in2d = (float*)malloc(size * sizeof(float));
+    float* in1c = (float*)malloc(size * sizeof(float));
+    float* in2c = (float*)malloc(size * sizeof(float));
+    float* out = (float*)malloc(2 * size * sizeof(float)); // full, then chunked
+    float* ref = (float*)malloc(2 * size * sizeof(float));
+    if (afe_ctx_init(&ctx, &config) != 0 || in1d == NULL || in2d == NULL || in1c == NULL || in2c == NULL || out == NULL || ref == NULL) {
+        fprintf(stderr, "Error at test initialization\n");
+        return 1;
+    }
+
+    stimuli_init(in1d, in2d, in1c, in2c, size, ctx.analog_fs);
+    run_chain(in1d, in2d, in1c, in2c, out, 0, &ctx);
+    run_chain(in1d, in2d, in1c, in2c, out + size, 1, &ctx);
+
+    #if defined(COLLAPSE_LINEAR) || defined(LTI_FFT)
+        FILE* file = fopen(argv[1], "rb");
+        if (file == NULL || fread(ref, sizeof(float), 2 * size, file) != (size_t) (2 * size)) {
+            fprintf(stderr, "Error reading reference file %s (written by the reference build)\n", argv[1]);
+            return 1;
+        }
+        fclose(file);
+        #ifdef COLLAPSE_LINEAR
+            compare("collapsed full", out, ref, size, COLLAPSE_RMS_TOL, COLLAPSE_MAX_TOL);
+            compare("collapsed chunked", out + size, ref + size, size, COLLAPSE_RMS_TOL, COLLAPSE_MAX_TOL);
+        #endif // COLLAPSE_LINEAR
+        #ifdef LTI_FFT
+            compare("lti fft full", out, ref, size, LTI_RMS_TOL, LTI_MAX_TOL);
+            compare("lti fft chunked", out + size, ref + size, size, LTI_RMS_TOL, LTI_MAX_TOL);
+        #endif // LTI_FFT
+    #else
+        // Reference: chunks give the same outputs as the full buffer (same kernels, states carried over)
+        int nmismatches = 0;
+        for (int i=0; i<size; i++) {
+            nmismatches += (out[size + i] != out[i]);
+        }
+        check("reference chunked mismatches", nmismatches, nmismatches == 0);
+        FILE* file = fopen(argv[1], "wb");
+        if (file == NULL || fwrite(out, sizeof(float), 2 * size, file) != (size_t) (2 * size)) {
+            fprintf(stderr, "Error writing reference file %s\n", argv[1]);
+            return 1;
+        }
+        fclose(file);
+        (void) ref;
+    #endif // COLLAPSE_LINEAR, LTI_FFT
+
+    afe_ctx_free(&ctx);
+    free(in1d);
+    free(in2d);
+    free(in1c);
+    free(in2c);
+    free(out);
+    free(ref);
+    printf("%s: %d failed\n", (nfailed == 0) ? "PASS" : "FAIL", nfailed);
+    return (nfailed == 0) ? 0 : 1;
+}
@@ -0,0 +1,169 @@
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "../include/setup.h"
+#include "../include/utils.h"
+#include "../include/dfilt.h"
+#include "../include/decim.h"
+#include "../include/afe_ctx.h"
+
+// Test of the fused digital filters and decimation (make test): dfiltDecimModule must be bit-identical to dfiltModule then
+// decimModule on the same ADC codes, for every run-time oversampling, on full buffers and on chunks of uneven sizes
+// Built once per variant of the digital filters (default, DFILT_FIXED, ADC_BITPLANES, IIR_BLOCK, see the Makefile)
+
+#define TEST_NCHUNK_SIZES 6 // Chunk sizes of the chunked runs, in output samples, cycled until the end of the buffer
+
+// Uneven chunks across the tile (DECIM_TILE_NSAMPLES) and block (IIR_BLOCK_NSAMPLES) boundaries
+static const int chunk_out_sizes[TEST_NCHUNK_SIZES] = {1, 3, 50, 7, 257, 1024};
+
+static int nfailed = 0;
+
+static void check(const char* name, double value, int passed) {
+
+    printf("%-40s %12.6f  %s\n", name, value, passed ? "PASS" : "FAIL");
+    nfailed += !passed;
+}
+
+// Chunk of the ADC output starting at offset (planes holds the pointers of the bits with ADC_BITPLANES)
+static adc_out_t adc_chunk(adc_out_t adc, int offset, int nbits, int** planes) {
+
+    #ifdef ADC_BITPLANES
+        for (int b=0; b<nbits; b++) {
+            planes[b] = adc[b] + offset;
+        }
+        return planes;
+    #else
+        (void) nbits;
+        (void) planes;
+        return adc + offset;
+    #endif // ADC_BITPLANES
+}
+
+// Runs dfiltModuleChunk then decimModuleChunk (fused == 0) or dfiltDecimModuleChunk (fused == 1) on the ADC codes of a
+// buffer, by chunks of chunk_out_sizes output samples (chunked == 1) or at once, from zeroed filter states
+static void run_decim(adc_out_t adc, int* full, int* out, int fused, int chunked, afe_ctx_t* ctx) {
+
+    int* planes[ADC_NBITS_MAX];
+    int osr_log = ctx->config.osr_log;
+    int size = ctx->adc_nsamples;
+    afe_ctx_reset(ctx);
+    int n;
+    for (int offset=0, c=0; offset<size; offset+=n, c++) {
+        n = chunked ? (chunk_out_sizes[c % TEST_NCHUNK_SIZES] << osr_log) : size;
+        n = (n < size - offset) ? n : size - offset;
+        adc_out_t in = adc_chunk(adc, offset, ctx->config.adc_nbits, planes);
+        if (fused) {
+            dfiltDecimModuleChunk(in, out + (offset >> osr_log), n, ctx);
+        } else {
+            dfiltModuleChunk(in, full + offset, n, ctx);
+            decimModuleChunk(full + offset, out + (offset >> osr_log), n, ctx);
+        }
+    }
+}
+
+// Random ADC codes over the whole range at the largest ADC rate, packed or one vector per bit with ADC_BITPLANES
+static adc_out_t adc_codes_alloc(int size, int nbits) {
+
+    rng_t rng;
+    rng_seed(&rng, SEED, 0, 0, 0);
+    #ifdef ADC_BITPLANES
+        int** adc = (int**)calloc(nbits, sizeof(int*));
+        int alloc_res = (adc == NULL);
+        for (int b=0; b<nbits && alloc_res == 0; b++) {
+            adc[b] = (int*)malloc(size * sizeof(int));
+            alloc_res = (adc[b] == NULL);
+        }
+        if (alloc_res != 0) {
+            return adc;
+        }
+        for (int i=0; i<size; i++) {
+            uint32_t code = rng_uint32(&rng) >> (32 - nbits);
+            for (int b=0; b<nbits; b++) {
+                adc[b][i] = (code >> (nbits - 1 - b)) & 1;
+            }
+        }
+    #else
+        uint16_t* adc = (uint16_t*)malloc(size * sizeof(uint16_t));
+        if (adc == NULL) {
+            return adc;
+        }
+        for (int i=0; i<size; i++) {
+            adc[i] = (uint16_t) (rng_uint32(&rng) >> (32 - nbits));
+        }
+    #endif // ADC_BITPLANES
+
+    return adc;
+}
+
+static void adc_codes_free(adc_out_t adc, int nbits) {
+
+    #ifdef ADC_BITPLANES
+        for (int b=0; adc != NULL && b<nbits; b++) {
+            free(adc[b]);
+        }
+    #else
+        (void) nbits;
+    #endif // ADC_BITPLANES
+    free(adc);
+}
+
+int main(void) {
+
+    // Largest oversampling accepted by afe_ctx_init (ADC rate up to FS)
+    int osr_log_max = 0;
+    while (osr_log_max < DECIM_OSR_LOG_MAX && OUT_FS_RATIO % (2 << osr_log_max) == 0) {
+        osr_log_max++;
+    }
+
+    afe_config_t config;
+    afe_config_default(&config);
+    int nbits = config.adc_nbits;
+    adc_out_t adc = adc_codes_alloc(N_SAMPLES, nbits);
+    int* full = (int*)malloc(N_SAMPLES * sizeof(int));
+    int* out_unfused = (int*)malloc(OUT_NSAMPLES * sizeof(int));
+    int* out_fused = (int*)malloc(OUT_NSAMPLES * sizeof(int));
+    #ifdef ADC_BITPLANES
+        int adc_res = (adc == NULL || adc[nbits - 1] == NULL);
+    #else
+        int adc_res = (adc == NULL);
+    #endif // ADC_BITPLANES
+    if (adc_res != 0 || full == NULL || out_unfused == NULL || out_fused == NULL) {
+        fprintf(stderr, "Error at test memory allocation\n");
+        return 1;
+    }
+
+    char name[64];
+    for (int osr_log=0; osr_log<=osr_log_max; osr_log++) {
+        config.osr_log = osr_log;
+        afe_ctx_t ctx;
+        if (afe_ctx_init(&ctx, &config) != 0) {
+            snprintf(name, sizeof(name), "osr 2^%d context", osr_log);
+            check(name, 0.0, 0);
+            afe_ctx_free(&ctx);
+            continue;
+        }
+        for (int chunked=0; chunked<2; chunked++) {
+            run_decim(adc, full, out_unfused, 0, chunked, &ctx);
+            run_decim(adc, full, out_fused, 1, chunked, &ctx);
+            int nmismatches = 0;
+            for (int i=0; i<OUT_NSAMPLES; i++) {
+                nmismatches += (out_fused[i] != out_unfused[i]);
+            }
+            snprintf(name, sizeof(name), "osr 2^%d %s fused mismatches", osr_log, chunked ? "chunked" : "full");
+            check(name, nmismatches, nmismatches == 0);
+        }
+        afe_ctx_free(&ctx);
+    }
+
+    adc_codes_free(adc, nbits);
+    free(full);
+    free(out_unfused);
+    free(out_fused);
+    printf("%s: %d failed\n", (nfailed == 0) ? "PASS" : "FAIL", nfailed);
+    return (nfailed == 0) ? 0 : 1;
+}
@@ -0,0 +1,228 @@
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "../include/setup.h"
+#include "../include/utils.h"
+#include "../include/afe_ctx.h"
+
+// Test of the block state-space IIR kernels (make test): iir_order_1_block, iir_order_2_block and iir_order_2_int_block against
+// the serial kernels of iir_order_1_chunk, iir_order_2_chunk and iir_order_2_int_chunk (this build has no IIR_BLOCK) and
+// against a double-precision serial reference, with the filters of the module chain (default cutoffs), on a whole buffer,
+// out of place and in place, and by chunks of uneven sizes continuing from the filter states
+// The bounds are those documented in utils.h, the blocks must also stay closer to the reference than the serial kernels
+// (an in-place block that reads back its own outputs as inputs is off by several % of the output RMS)
+
+#define TEST_NCHUNK_SIZES 6 // Chunk sizes of the chunked runs, cycled until the end of the buffer
+
+#define BLOCK_RMS_TOL 2e-7 // Error RMS of the float block kernels relative to the output RMS (documented: below 1.3e-7)
+#define BLOCK_CHUNKED_RMS_TOL 2e-3 // Same by chunks, the state rounded to float at each call (measured 8e-4 for the AFILT HPF)
+#define BLOCK_INT_MAX_TOL 2 // Largest error of the int block kernel in LSB (documented: within 1.3 LSB)
+#define TEST_INT_RMS 2000.0f // RMS of the white part of the int input, in LSB of the DFILT input (OUT_NBITS)
+
+// Uneven chunks across the block boundaries (IIR_BLOCK_NSAMPLES)
+static const int chunk_sizes[TEST_NCHUNK_SIZES] = {1, 3, 8, 13, 1021, 4096};
+
+static int nfailed = 0;
+
+static void check(const char* name, double value, int passed) {
+
+    printf("%-40s %12.6g  %s\n", name, value, passed ? "PASS" : "FAIL");
+    nfailed += !passed;
+}
+
+// Float filter of the chain
+typedef struct {
+    const char*     name;
+    int             order;
+    float*          alpha;
+    float*          beta;
+} test_filter_t;
+
+// Serial filter in double, with the coefficients normalized in float as the kernels do
+static void iir_reference(const float* in, double* out, int size, const test_filter_t* filter) {
+
+    float* alpha = filter->alpha;
+    float* beta = filter->beta;
+    double a1 = alpha[1] / alpha[0];
+    double a2 = (filter->order > 1) ? alpha[2] / alpha[0] : 0.0f;
+    double b0 = beta[0] / alpha[0];
+    double b1 = beta[1] / alpha[0];
+    double b2 = (filter->order > 1) ? beta[2] / alpha[0] : 0.0f;
+    double x1 = 0.0, x2 = 0.0, y1 = 0.0, y2 = 0.0;
+    for (int i=0; i<size; i++) {
+        double y = b0 * in[i] + b1 * x1 + b2 * x2 - a1 * y1 - a2 * y2;
+        x2 = x1;
+        x1 = in[i];
+        y2 = y1;
+        y1 = y;
+        out[i] = y;
+    }
+}
+
+// Filters in into out (can be the same) with the block (block == 1) or the serial kernel, at once (chunked == 0) or by chunks
+static void iir_run(float* in, float* out, int size, const test_filter_t* filter, int block, int chunked) {
+
+    iir1_state_t state1 = {0};
+    iir2_state_t state2 = {0};
+    int n;
+    for (int offset=0, c=0; offset<size; offset+=n, c++) {
+        n = chunked ? chunk_sizes[c % TEST_NCHUNK_SIZES] : size;
+        n = (n < size - offset) ? n : size - offset;
+        if (filter->order == 1) {
+            if (block) {
+                iir_order_1_block(in + offset, out + offset, n, filter->alpha, filter->beta, &state1);
+            } else {
+                iir_order_1_chunk(in + offset, out + offset, n, filter->alpha, filter->beta, &state1);
+            }
+        } else {
+            if (block) {
+                iir_order_2_block(in + offset, out + offset, n, filter->alpha, filter->beta, &state2);
+            } else {
+                iir_order_2_chunk(in + offset, out + offset, n, filter->alpha, filter->beta, &state2);
+            }
+        }
+    }
+}
+
+// Error RMS of out against the reference, relative to the RMS of the reference
+static double relative_error(const float* out, const double* ref, int size) {
+
+    double ref_power = 0.0, err_power = 0.0;
+    for (int i=0; i<size; i++) {
+        ref_power += ref[i] * ref[i];
+        err_power += (out[i] - ref[i]) * (out[i] - ref[i]);
+    }
+
+    return sqrt(err_power / ref_power);
+}
+
+static void test_float_filter(const test_filter_t* filter, const float* in, float* out, double* ref, int size) {
+
+    char name[64];
+    iir_reference(in, ref, size, filter);
+    iir_run((float*) in, out, size, filter, 0, 0);
+    double serial_err = relative_error(out, ref, size);
+    snprintf(name, sizeof(name), "%s serial error RMS", filter->name);
+    check(name, serial_err, 1);
+
+    static const char* runs[4] = {"out of place", "in place", "chunked out of place", "chunked in place"};
+    for (int r=0; r<4; r++) {
+        int in_place = r & 1;
+        int chunked = r >> 1;
+        if (in_place) {
+            memcpy(out, in, size * sizeof(float));
+        }
+        iir_run(in_place ? out : (float*) in, out, size, filter, 1, chunked);
+        double block_err = relative_error(out, ref, size);
+        snprintf(name, sizeof(name), "%s block %s", filter->name, runs[r]);
+        double tol = chunked ? BLOCK_CHUNKED_RMS_TOL : BLOCK_RMS_TOL;
+        check(name, block_err, block_err < tol && block_err <= serial_err + BLOCK_RMS_TOL);
+    }
+}
+
+// Int kernels (digital filters) on ADC-like codes, against the rounded reference
+static void test_int_filter(const test_filter_t* filter, const int* in, int* out, float* in_float, double* ref, int size) {
+
+    char name[64];
+    for (int i=0; i<size; i++) {
+        in_float[i] = (float) in[i];
+    }
+    iir_reference(in_float, ref, size, filter);
+    iir2_state_t state = {0};
+    iir_order_2_int_chunk((int*) in, out, size, filter->alpha, filter->beta, &state);
+    int serial_err = 0;
+    for (int i=0; i<size; i++) {
+        int err = abs(out[i] - (int) lround(ref[i]));
+        serial_err = (err > serial_err) ? err : serial_err;
+    }
+    snprintf(name, sizeof(name), "%s serial error max (LSB)", filter->name);
+    check(name, serial_err, 1);
+
+    static const char* runs[2] = {"in place", "chunked in place"};
+    for (int chunked=0; chunked<2; chunked++) {
+        memcpy(out, in, size * sizeof(int));
+        state = (iir2_state_t){0};
+        int n;
+        for (int offset=0, c=0; offset<size; offset+=n, c++) {
+            n = chunked ? chunk_sizes[c % TEST_NCHUNK_SIZES] : size;
+            n = (n < size - offset) ? n : size - offset;
+            iir_order_2_int_block(out + offset, out + offset, n, filter->alpha, filter->beta, &state);
+        }
+        int block_err = 0;
+        for (int i=0; i<size; i++) {
+            int err = abs(out[i] - (int) lround(ref[i]));
+            block_err = (err > block_err) ? err : block_err;
+        }
+        snprintf(name, sizeof(name), "%s int block %s (LSB)", filter->name, runs[chunked]);
+        check(name, block_err, block_err <= BLOCK_INT_MAX_TOL);
+    }
+}
+
+int main(void) {
+
+    afe_ctx_t ctx;
+    int size = N_SAMPLES;
+    float* in = (float*)malloc(size * sizeof(float));
+    float* out = (float*)malloc(size * sizeof(float));
+    double* ref = (double*)malloc(size * sizeof(double));
+    int* in_int = (int*)malloc(size * sizeof(int));
+    int* out_int = (int*)malloc(size * sizeof(int));
+    if (afe_ctx_init(&ctx, NULL) != 0 || in == NULL || out == NULL || ref == NULL || in_int == NULL || out_int == NULL) {
+        fprintf(stderr, "Error at test initialization\n");
+        return 1;
+    }
+
+    // White noise and a tone in the passband of all filters
+    rng_t rng;
+    rng_seed(&rng, SEED, 0, 0, 0);
+    gaussian_generator(in, size, 1.0f, &rng);
+    for (int i=0; i<size; i++) {
+        in[i] += (float) sin(TWO_PI * 1000.0 * i / ctx.analog_fs);
+    }
+
+    analog_coefs_t* analog = &ctx.analog_coefs;
+    test_filter_t filters[4] = {
+        {"pcb hpf", 1, analog->pcb_alpha, analog->pcb_beta},
+        {"ia lpf", 1, analog->ia_alpha, analog->ia_beta},
+        {"afilt hpf", 2, analog->afilt_hpf_alpha, analog->afilt_hpf_beta},
+        {"afilt lpf", 2, analog->afilt_lpf_alpha, analog->afilt_lpf_beta},
+    };
+    for (int f=0; f<4; f++) {
+        test_float_filter(&filters[f], in, out, ref, ctx.analog_nsamples);
+    }
+
+    // Digital filters at the ADC rate, on codes at OUT_NBITS
+    gaussian_generator(in, size, TEST_INT_RMS, &rng);
+    for (int i=0; i<ctx.adc_nsamples; i++) {
+        in_int[i] = (int) lroundf(in[i] + 4.0f * TEST_INT_RMS * (float) sin(TWO_PI * 1000.0 * i / (FS / ctx.adc_fs_ratio)));
+    }
+    dfilt_coefs_t* dfilt = &ctx.dfilt_coefs;
+    float dfilt_alpha[2][3], dfilt_beta[2][3];
+    for (int k=0; k<3; k++) {
+        dfilt_alpha[0][k] = (float) dfilt->hpf_alpha[k];
+        dfilt_beta[0][k] = (float) dfilt->hpf_beta[k];
+        dfilt_alpha[1][k] = (float) dfilt->lpf_alpha[k];
+        dfilt_beta[1][k] = (float) dfilt->lpf_beta[k];
+    }
+    test_filter_t int_filters[2] = {
+        {"dfilt hpf", 2, dfilt_alpha[0], dfilt_beta[0]},
+        {"dfilt lpf", 2, dfilt_alpha[1], dfilt_beta[1]},
+    };
+    for (int f=0; f<2; f++) {
+        test_int_filter(&int_filters[f], in_int, out_int, in, ref, ctx.adc_nsamples);
+    }
+
+    afe_ctx_free(&ctx);
+    free(in);
+    free(out);
+    free(ref);
+    free(in_int);
+    free(out_int);
+    printf("%s: %d failed\n", (nfailed == 0) ? "PASS" : "FAIL", nfailed);
+    return (nfailed == 0) ? 0 : 1;
+}
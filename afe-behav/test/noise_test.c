@@ -0,0 +1,347 @@
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "../include/setup.h"
+#include "../include/utils.h"
+
+// Tests of the noise generators (make test): known answers of the Philox4x32-10 generator, skip-ahead and batches against
+// sequential draws, distribution and spectrum of gaussian_generator, PSD slope of the Voss-McCartney pink noise of
+// pink_noise_generator_chunk
+// Fixed seeds, the tolerances are several standard deviations of the estimates (a failure is a real change of the generators)
+
+#define TEST_NSAMPLES (1 << 22) // Samples per test vector
+#define TEST_NSEEDS 4 // Seeds of the distribution tests
+#define TEST_NFFT 65536 // FFT size of the spectral estimates (averaged periodograms)
+
+#define MEAN_TOL 0.003f // 6 standard deviations of the mean of TEST_NSAMPLES samples
+#define VAR_TOL 0.005f // 7 standard deviations of the variance
+#define SKEW_TOL 0.01f // 8 standard deviations of the skewness
+#define KURT_TOL 0.02f // 8 standard deviations of the excess kurtosis
+#define KS_TOL 1.63f // Kolmogorov-Smirnov statistic sqrt(n) * D, 1 % significance level
+#define FLATNESS_MIN 0.98f // Spectral flatness of the white noise (geometric over arithmetic mean of the averaged periodogram)
+#define OCTAVE_TOL 0.05f // Relative deviation of the octave powers of the white noise from their mean
+#define PINK_SLOPE_TOL 0.05f // Deviation of the log-log PSD slope of the pink noise from -1
+#define PINK_FIRST_OCTAVE 2 // Octaves of FFT bins [2^o, 2^(o+1)) fitted for the pink noise slope
+#define PINK_LAST_OCTAVE 11
+#define RNG_NSEQ 65536 // Sequential draws compared with the skip-ahead and the batches
+
+// Published known-answer vectors of Philox4x32-10 (Random123 kat_vectors): counter, key, output
+static const uint32_t philox_kat[3][10] = {
+    {0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8},
+    {0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff, 0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd},
+    {0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344, 0xa4093822, 0x299f31d0, 0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1},
+};
+
+static int nfailed = 0;
+
+static void check(const char* name, double value, int passed) {
+
+    printf("%-40s %12.6f  %s\n", name, value, passed ? "PASS" : "FAIL");
+    nfailed += !passed;
+}
+
+static int compare_floats(const void* a, const void* b) {
+
+    float x = *(const float*) a;
+    float y = *(const float*) b;
+    return (x > y) - (x < y);
+}
+
+// Averaged Hann-windowed periodogram of x, per FFT bin in natural order from 0 to TEST_NFFT / 2 - 1 (arbitrary scale)
+static int periodogram(const float* x, int size, double* psd) {
+
+    float* re = (float*)malloc(TEST_NFFT * sizeof(float));
+    float* im = (float*)malloc(TEST_NFFT * sizeof(float));
+    float* tw_re = (float*)malloc(TEST_NFFT * sizeof(float));
+    float* tw_im = (float*)malloc(TEST_NFFT * sizeof(float));
+    if (re == NULL || im == NULL || tw_re == NULL || tw_im == NULL) {
+        free(re);
+        free(im);
+        free(tw_re);
+        free(tw_im);
+        return 1;
+    }
+    fft_init(tw_re, tw_im, TEST_NFFT);
+    int log_nfft = 0;
+    while ((1 << log_nfft) < TEST_NFFT) {
+        log_nfft++;
+    }
+
+    memset(psd, 0, TEST_NFFT / 2 * sizeof(double));
+    for (int offset=0; offset + TEST_NFFT <= size; offset+=TEST_NFFT) {
+        for (int i=0; i<TEST_NFFT; i++) {
+            re[i] = x[offset + i] * (float) (0.5 - 0.5 * cos(TWO_PI * i / TEST_NFFT));
+            im[i] = 0.0f;
+        }
+        fft_forward(re, im, TEST_NFFT, tw_re, tw_im);
+        // Spectrum in bit-reversed order
+        for (int p=0; p<TEST_NFFT; p++) {
+            int k = 0;
+            for (int b=0; b<log_nfft; b++) {
+                k |= ((p >> b) & 1) << (log_nfft - 1 - b);
+            }
+            if (k < TEST_NFFT / 2) {
+                psd[k] += (double) re[p] * re[p] + (double) im[p] * im[p];
+            }
+        }
+    }
+
+    free(re);
+    free(im);
+    free(tw_re);
+    free(tw_im);
+    return 0;
+}
+
+// Known answers of the block encryption, counter (block, stream) and key set as in the published vectors
+static void test_philox_kat(void) {
+
+    char name[64];
+    for (int v=0; v<3; v++) {
+        const uint32_t* kat = philox_kat[v];
+        rng_t rng;
+        rng_seed(&rng, SEED, 0, 0, 0);
+        rng.stream[0] = kat[2];
+        rng.stream[1] = kat[3];
+        rng.key[0] = kat[4];
+        rng.key[1] = kat[5];
+        uint32_t out[4];
+        rng_block(&rng, (uint64_t) kat[0] | ((uint64_t) kat[1] << 32), out);
+        int nmismatches = 0;
+        for (int w=0; w<4; w++) {
+            nmismatches += (out[w] != kat[6 + w]);
+        }
+        snprintf(name, sizeof(name), "philox known answer %d mismatches", v);
+        check(name, nmismatches, nmismatches == 0);
+    }
+}
+
+// Skip-ahead and batches against sequential draws of the same stream, from any position (inside a block or not)
+static void test_rng_sequence(void) {
+
+    uint32_t* seq = (uint32_t*)malloc(RNG_NSEQ * sizeof(uint32_t));
+    uint32_t* batch = (uint32_t*)malloc(RNG_NSEQ * sizeof(uint32_t));
+    float* uniform = (float*)malloc(RNG_NSEQ * sizeof(float));
+    if (seq == NULL || batch == NULL || uniform == NULL) {
+        check("rng sequence allocation", 0.0, 0);
+        free(seq);
+        free(batch);
+        free(uniform);
+        return;
+    }
+    rng_t rng;
+    rng_seed(&rng, SEED, 1, 2, 3);
+    for (int i=0; i<RNG_NSEQ; i++) {
+        seq[i] = rng_uint32(&rng);
+    }
+
+    // Skips from a fresh generator and from a partly drawn block, then a few draws
+    static const int skips[8] = {0, 1, 3, 4, 5, 31, 4097, 40001};
+    int nmismatches = 0;
+    for (int s=0; s<8; s++) {
+        for (int drawn=0; drawn<3; drawn++) {
+            rng_seed(&rng, SEED, 1, 2, 3);
+            for (int i=0; i<drawn; i++) {
+                rng_uint32(&rng);
+            }
+            rng_skip(&rng, skips[s]);
+            for (int i=drawn+skips[s]; i<drawn+skips[s]+64; i++) {
+                nmismatches += (rng_uint32(&rng) != seq[i]);
+            }
+        }
+    }
+    check("rng skip mismatches", nmismatches, nmismatches == 0);
+
+    // Far skips: draw n is word n % 4 of block n / 4, and two skips add up
+    static const uint64_t far_skips[3] = {(1ULL << 32) + 3, (1ULL << 40) + 6, (1ULL << 61) + 1};
+    nmismatches = 0;
+    for (int s=0; s<3; s++) {
+        rng_t rng_far;
+        rng_seed(&rng_far, SEED, 1, 2, 3);
+        rng_skip(&rng_far, far_skips[s]);
+        rng_seed(&rng, SEED, 1, 2, 3);
+        rng_skip(&rng, far_skips[s] / 2);
+        rng_skip(&rng, far_skips[s] - far_skips[s] / 2);
+        for (uint64_t n=far_skips[s]; n<far_skips[s]+16; n++) {
+            uint32_t out[4];
+            rng_block(&rng_far, n >> 2, out);
+            uint32_t draw = rng_uint32(&rng_far);
+            nmismatches += (draw != out[n & 3]) + (rng_uint32(&rng) != draw);
+        }
+    }
+    check("rng far skip mismatches", nmismatches, nmismatches == 0);
+
+    // Batches of any size from any position, integers and floats
+    static const int batch_sizes[6] = {1, 3, 31, 32, 33, 1000};
+    nmismatches = 0;
+    for (int drawn=0; drawn<5; drawn++) {
+        rng_seed(&rng, SEED, 1, 2, 3);
+        rng_skip(&rng, drawn);
+        int offset = drawn;
+        for (int b=0; offset + batch_sizes[b % 6] <= RNG_NSEQ; b++) {
+            rng_uint32_batch(&rng, batch, batch_sizes[b % 6]);
+            for (int i=0; i<batch_sizes[b % 6]; i++) {
+                nmismatches += (batch[i] != seq[offset + i]);
+            }
+            offset += batch_sizes[b % 6];
+        }
+        rng_seed(&rng, SEED, 1, 2, 3);
+        rng_skip(&rng, drawn);
+        rng_uniform_batch(&rng, uniform, RNG_NSEQ - drawn);
+        for (int i=0; i<RNG_NSEQ - drawn; i++) {
+            nmismatches += (uniform[i] != (float) (seq[drawn + i] >> 8) * (1.0f / 16777216.0f));
+        }
+    }
+    check("rng batch mismatches", nmismatches, nmismatches == 0);
+
+    free(seq);
+    free(batch);
+    free(uniform);
+}
+
+// Moments and Kolmogorov-Smirnov statistic of unit gaussian noise, for several seeds
+static void test_gaussian_distribution(float* x) {
+
+    char name[64];
+    for (int s=0; s<TEST_NSEEDS; s++) {
+        rng_t rng;
+        rng_seed(&rng, SEED + s, 0, 0, 0);
+        gaussian_generator(x, TEST_NSAMPLES, 1.0f, &rng);
+
+        double m1 = 0.0, m2 = 0.0, m3 = 0.0, m4 = 0.0;
+        for (int i=0; i<TEST_NSAMPLES; i++) {
+            m1 += x[i];
+        }
+        m1 /= TEST_NSAMPLES;
+        for (int i=0; i<TEST_NSAMPLES; i++) {
+            double d = x[i] - m1;
+            m2 += d * d;
+            m3 += d * d * d;
+            m4 += d * d * d * d;
+        }
+        m2 /= TEST_NSAMPLES;
+        m3 /= TEST_NSAMPLES;
+        m4 /= TEST_NSAMPLES;
+        double skewness = m3 / pow(m2, 1.5);
+        double kurtosis = m4 / (m2 * m2) - 3.0;
+
+        snprintf(name, sizeof(name), "gaussian seed %d mean", SEED + s);
+        check(name, m1, fabs(m1) < MEAN_TOL);
+        snprintf(name, sizeof(name), "gaussian seed %d variance", SEED + s);
+        check(name, m2, fabs(m2 - 1.0) < VAR_TOL);
+        snprintf(name, sizeof(name), "gaussian seed %d skewness", SEED + s);
+        check(name, skewness, fabs(skewness) < SKEW_TOL);
+        snprintf(name, sizeof(name), "gaussian seed %d excess kurtosis", SEED + s);
+        check(name, kurtosis, fabs(kurtosis) < KURT_TOL);
+
+        // Largest distance between the empirical and the normal cumulative distributions
+        qsort(x, TEST_NSAMPLES, sizeof(float), compare_floats);
+        double d_max = 0.0;
+        for (int i=0; i<TEST_NSAMPLES; i++) {
+            double cdf = 0.5 * erfc(-x[i] / sqrt(2.0));
+            double d_low = fabs(cdf - (double) i / TEST_NSAMPLES);
+            double d_high = fabs((double) (i + 1) / TEST_NSAMPLES - cdf);
+            d_max = (d_low > d_max) ? d_low : d_max;
+            d_max = (d_high > d_max) ? d_high : d_max;
+        }
+        double ks = sqrt((double) TEST_NSAMPLES) * d_max;
+        snprintf(name, sizeof(name), "gaussian seed %d KS sqrt(n)*D", SEED + s);
+        check(name, ks, ks < KS_TOL);
+    }
+}
+
+// Flat spectrum of the gaussian noise: spectral flatness and octave powers
+static void test_gaussian_spectrum(float* x, double* psd) {
+
+    rng_t rng;
+    rng_seed(&rng, SEED, 0, 0, 0);
+    gaussian_generator(x, TEST_NSAMPLES, 1.0f, &rng);
+    if (periodogram(x, TEST_NSAMPLES, psd) != 0) {
+        check("gaussian periodogram allocation", 0.0, 0);
+        return;
+    }
+
+    double log_sum = 0.0, sum = 0.0;
+    int nbins = 0;
+    for (int k=1; k<TEST_NFFT/2; k++) {
+        log_sum += log(psd[k]);
+        sum += psd[k];
+        nbins++;
+    }
+    double flatness = exp(log_sum / nbins) / (sum / nbins);
+    check("gaussian spectral flatness", flatness, flatness > FLATNESS_MIN);
+
+    // Octaves of at least 128 bins, power per bin relative to the whole band
+    double max_dev = 0.0;
+    for (int o=7; (1 << o) < TEST_NFFT/2; o++) {
+        double octave_sum = 0.0;
+        for (int k=(1 << o); k<(2 << o) && k<TEST_NFFT/2; k++) {
+            octave_sum += psd[k];
+        }
+        int octave_nbins = ((2 << o) < TEST_NFFT/2) ? (1 << o) : TEST_NFFT/2 - (1 << o);
+        double dev = fabs(octave_sum / octave_nbins / (sum / nbins) - 1.0);
+        max_dev = (dev > max_dev) ? dev : max_dev;
+    }
+    check("gaussian max octave deviation", max_dev, max_dev < OCTAVE_TOL);
+}
+
+// Slope of the PSD of the Voss-McCartney pink noise (unit sources), least squares on the log-log octave powers per bin
+static void test_pink_slope(float* x, double* psd) {
+
+    rng_t rng;
+    rng_seed(&rng, SEED, 0, 0, 0);
+    pink_state_t state;
+    gaussian_generator(state.sources, PINK_NOISE_NSOURCES, 1.0f, &rng);
+    state.running_sum = sumf(state.sources, PINK_NOISE_NSOURCES);
+    state.source_scale = 1.0f;
+    state.key = 0;
+    pink_noise_generator_chunk(x, TEST_NSAMPLES, &state, &rng);
+    if (periodogram(x, TEST_NSAMPLES, psd) != 0) {
+        check("pink periodogram allocation", 0.0, 0);
+        return;
+    }
+
+    double sx = 0.0, sy = 0.0, sxx = 0.0, sxy = 0.0;
+    int n = 0;
+    for (int o=PINK_FIRST_OCTAVE; o<=PINK_LAST_OCTAVE; o++) {
+        double octave_sum = 0.0;
+        for (int k=(1 << o); k<(2 << o); k++) {
+            octave_sum += psd[k];
+        }
+        double lx = log10(1.5 * (1 << o)); // centre of the octave
+        double ly = log10(octave_sum / (1 << o));
+        sx += lx;
+        sy += ly;
+        sxx += lx * lx;
+        sxy += lx * ly;
+        n++;
+    }
+    double slope = (n * sxy - sx * sy) / (n * sxx - sx * sx);
+    check("pink PSD log-log slope", slope, fabs(slope + 1.0) < PINK_SLOPE_TOL);
+}
+
+int main(void) {
+
+    float* x = (float*)malloc(TEST_NSAMPLES * sizeof(float));
+    double* psd = (double*)malloc(TEST_NFFT / 2 * sizeof(double));
+    if (x == NULL || psd == NULL) {
+        fprintf(stderr, "Error at test memory allocation\n");
+        return 1;
+    }
+
+    test_philox_kat();
+    test_rng_sequence();
+    test_gaussian_distribution(x);
+    test_gaussian_spectrum(x, psd);
+    test_pink_slope(x, psd);
+
+    free(x);
+    free(psd);
+    printf("%s: %d failed\n", (nfailed == 0) ? "PASS" : "FAIL", nfailed);
+    return (nfailed == 0) ? 0 : 1;
+}
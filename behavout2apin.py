@@ -13,8 +13,9 @@ APIN_FOLDER = './outputs/ref/ap_in/'
 SUBJECTS = ['P1', 'P2', 'P3', 'P4', 'P5', 'P6', 'S1', 'S2']
 NBUFFERS = 3720
 FS = 20e3 # the AP detection algo expects data at 20 kS/S. If the behav model gives results at another rate, the data must be re-sampled
-BEHAVOUT_BUFFERSIZE = 20000
+CONTINUOUS = False # must match CONTINUOUS in afe-behav/include/setup.h (the behav model then only outputs the central 0.5 s of each buffer)
 APIN_BUFFERSIZE = 10000
+BEHAVOUT_BUFFERSIZE = APIN_BUFFERSIZE if CONTINUOUS else 20000
 PRE_PADDING_SIZE = int(np.round(BEHAVOUT_BUFFERSIZE - APIN_BUFFERSIZE)/2)
 POST_PADDING_SIZE = int(np.round(BEHAVOUT_BUFFERSIZE - APIN_BUFFERSIZE)/2)
 APIN_IDX = range(PRE_PADDING_SIZE, PRE_PADDING_SIZE+APIN_BUFFERSIZE)